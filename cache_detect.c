@@ -1,4 +1,8 @@
-#if !defined(_WIN32)
+#if defined(__linux__)
+#  if !defined(_GNU_SOURCE)
+#    define _GNU_SOURCE // sched_setaffinity, sched_getcpu, RUSAGE_THREAD
+#  endif
+#elif !defined(_WIN32)
 #  if !defined(_POSIX_C_SOURCE)
 #    define _POSIX_C_SOURCE 200809L
 #  endif
@@ -15,12 +19,42 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <pthread.h>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 
 #if defined(__APPLE__)
 #include <mach/mach_time.h>
 #endif
 
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#include <cpuid.h>
+#define HAVE_X86_INTRINSICS 1
+// SSE2 is baseline on x86-64 only; i386/i686 builds compile these kernels for it anyway and
+// register them after __builtin_cpu_supports("sse2")
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#endif
+#if defined(__ARM_FEATURE_SVE)
+#include <arm_sve.h>
+#endif
+#if defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#include <arm_neon.h>
+#define HAVE_NEON 1
+#endif
+
 // Prevent elimination by optimizer
 static volatile void *volatile g_sink;
 
@@ -48,6 +82,134 @@ static uint64_t now_ns(void) {
 #endif
 }
 
+static void sleep_ms(unsigned ms) {
+	struct timespec ts;
+	ts.tv_sec = (time_t)(ms / 1000u);
+	ts.tv_nsec = (long)(ms % 1000u) * 1000000L;
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+	}
+}
+
+// Where the tool's own time goes. Always on: one now_ns() pair per phase entry, nothing per
+// access. Modes with their own timing loops only show up in the wall-clock remainder.
+// Per thread: parallel sweep workers add their totals to the main thread's when they finish.
+typedef enum Phase {
+	PHASE_ALLOC = 0, // buffer and scratch allocation
+	PHASE_MEMSET,    // prefaulting
+	PHASE_BUILD,     // order generation and cycle linking
+	PHASE_WARMUP,    // untimed passes before measuring
+	PHASE_CALIBRATE, // run-length adaptation
+	PHASE_TIMED,     // measured chasing
+	PHASE_COUNT
+} Phase;
+
+static _Thread_local uint64_t g_phase_ns[PHASE_COUNT];
+
+static const char *phase_name(Phase p) {
+	static const char *names[PHASE_COUNT] = {"alloc", "memset", "build", "warmup", "calibrate", "timed"};
+	return p < PHASE_COUNT ? names[p] : "?";
+}
+
+static inline void phase_add(Phase p, uint64_t t0) {
+	g_phase_ns[p] += now_ns() - t0;
+}
+
+// RAPL energy counters (powercap sysfs), read around timed regions when --energy is set.
+// Package zones include the cores, uncore and L3; DRAM zones only exist on some parts.
+typedef enum EnergyDomain {
+	ENERGY_PKG = 0,
+	ENERGY_DRAM,
+	ENERGY_DOMAINS
+} EnergyDomain;
+
+#define MAX_RAPL_ZONES 16
+
+typedef struct RaplZone {
+	char path[512];      // .../energy_uj
+	EnergyDomain domain;
+	uint64_t range_uj;   // counter wraps at max_energy_range_uj
+} RaplZone;
+
+static RaplZone g_rapl[MAX_RAPL_ZONES];
+static size_t g_rapl_count;
+static bool g_rapl_has[ENERGY_DOMAINS];
+
+// Energy and accesses accumulated over all sampled regions; callers diff snapshots
+typedef struct EnergyTotals {
+	double uj[ENERGY_DOMAINS];
+	double accesses;
+} EnergyTotals;
+
+static EnergyTotals g_energy;
+
+static const char *energy_domain_name(EnergyDomain d) {
+	return d == ENERGY_PKG ? "pkg" : "dram";
+}
+
+static bool read_u64_file(const char *path, uint64_t *v) {
+	FILE *f = fopen(path, "r");
+	if (!f) return false;
+	bool ok = fscanf(f, "%" SCNu64, v) == 1;
+	fclose(f);
+	return ok;
+}
+
+// Find readable package and DRAM zones under root (normally /sys/class/powercap). Zones are
+// intel-rapl:N (packages, also on AMD) and intel-rapl:N:M subzones; psys, core and uncore are
+// skipped so package energy is not counted twice. Returns the number of usable zones.
+static size_t rapl_open(const char *root) {
+	g_rapl_count = 0;
+	memset(g_rapl_has, 0, sizeof(g_rapl_has));
+	DIR *d = opendir(root);
+	if (!d) return 0;
+	struct dirent *e;
+	while ((e = readdir(d)) != NULL && g_rapl_count < MAX_RAPL_ZONES) {
+		if (strncmp(e->d_name, "intel-rapl:", 11) != 0) continue;
+		char path[768], name[64] = "";
+		snprintf(path, sizeof(path), "%s/%s/name", root, e->d_name);
+		FILE *f = fopen(path, "r");
+		if (!f) continue;
+		if (!fgets(name, sizeof(name), f)) name[0] = '\0';
+		fclose(f);
+		EnergyDomain dom;
+		if (strncmp(name, "package", 7) == 0) dom = ENERGY_PKG;
+		else if (strncmp(name, "dram", 4) == 0) dom = ENERGY_DRAM;
+		else continue;
+		RaplZone *z = &g_rapl[g_rapl_count];
+		snprintf(z->path, sizeof(z->path), "%s/%s/energy_uj", root, e->d_name);
+		uint64_t v;
+		if (!read_u64_file(z->path, &v)) continue; // often root-only
+		snprintf(path, sizeof(path), "%s/%s/max_energy_range_uj", root, e->d_name);
+		if (!read_u64_file(path, &z->range_uj)) z->range_uj = 0;
+		z->domain = dom;
+		g_rapl_has[dom] = true;
+		g_rapl_count++;
+	}
+	closedir(d);
+	return g_rapl_count;
+}
+
+static void energy_read(uint64_t *uj) {
+	for (size_t i = 0; i < g_rapl_count; ++i) {
+		if (!read_u64_file(g_rapl[i].path, &uj[i])) uj[i] = 0;
+	}
+}
+
+// Add the energy between two energy_read snapshots and the accesses made in between
+static void energy_add(const uint64_t *start, const uint64_t *end, double accesses) {
+	for (size_t i = 0; i < g_rapl_count; ++i) {
+		uint64_t d = end[i] >= start[i] ? end[i] - start[i] : end[i] + g_rapl[i].range_uj - start[i];
+		g_energy.uj[g_rapl[i].domain] += (double)d;
+	}
+	g_energy.accesses += accesses;
+}
+
+// nJ per access per domain since snapshot t0; 0 when nothing was sampled
+static void energy_since(const EnergyTotals *t0, double *nj) {
+	double n = g_energy.accesses - t0->accesses;
+	for (int d = 0; d < ENERGY_DOMAINS; ++d) nj[d] = n > 0.0 ? (g_energy.uj[d] - t0->uj[d]) * 1000.0 / n : 0.0;
+}
+
 // Simple xorshift64 RNG for reproducible shuffles
 typedef struct Random64 {
 	uint64_t state;
@@ -108,15 +270,19 @@ typedef enum Pattern {
 	PATTERN_BITREVERSE
 } Pattern;
 
-// Build using a specific order array
-static void build_cycle_from_order(uint8_t *base, size_t num_nodes, size_t node_stride, const size_t *order) {
+// Build using a specific order array.
+// The next pointer lives ptr_offset bytes into each node and points at the same offset of
+// the next node; a non-zero offset lets the pointer straddle a cache-line or page boundary.
+static void build_cycle_from_order(uint8_t *base, size_t num_nodes, size_t node_stride, const size_t *order, size_t ptr_offset) {
+	uint64_t t0 = now_ns();
 	for (size_t i = 0; i < num_nodes; ++i) {
 		size_t from = order[i];
 		size_t to = order[(i + 1) % num_nodes];
-		uint8_t *from_ptr = base + from * node_stride;
-		uint8_t *to_ptr = base + to * node_stride;
-		*(void **)from_ptr = (void *)to_ptr;
+		uint8_t *from_ptr = base + from * node_stride + ptr_offset;
+		void *to_ptr = (void *)(base + to * node_stride + ptr_offset);
+		memcpy(from_ptr, &to_ptr, sizeof(to_ptr)); // may be unaligned
 	}
+	phase_add(PHASE_BUILD, t0);
 }
 
 static void build_order_random(size_t *order, size_t num_nodes, Random64 *rng) {
@@ -209,7 +375,8 @@ static void build_order_bitrev(size_t *order, size_t num_nodes) {
 	}
 }
 
-static void build_cycle_pattern(uint8_t *base, size_t num_nodes, size_t node_stride, size_t *order, Random64 *rng, Pattern p, size_t pattern_arg) {
+static void build_order_pattern(size_t *order, size_t num_nodes, Random64 *rng, Pattern p, size_t pattern_arg) {
+	uint64_t t0 = now_ns();
 	switch (p) {
 		case PATTERN_RANDOM:      build_order_random(order, num_nodes, rng); break;
 		case PATTERN_SEQUENTIAL:  build_order_sequential(order, num_nodes); break;
@@ -220,14 +387,90 @@ static void build_cycle_pattern(uint8_t *base, size_t num_nodes, size_t node_str
 		case PATTERN_BITREVERSE:  build_order_bitrev(order, num_nodes); break;
 		default:                  build_order_random(order, num_nodes, rng); break;
 	}
-	build_cycle_from_order(base, num_nodes, node_stride, order);
+	phase_add(PHASE_BUILD, t0);
+}
+
+static void build_cycle_pattern(uint8_t *base, size_t num_nodes, size_t node_stride, size_t *order, Random64 *rng, Pattern p, size_t pattern_arg, size_t ptr_offset) {
+	build_order_pattern(order, num_nodes, rng, p, pattern_arg);
+	build_cycle_from_order(base, num_nodes, node_stride, order, ptr_offset);
+}
+
+// Keyed bijection on [0, n): a 4-round unbalanced Feistel network over the next power of two
+// (the halves take turns being xored with a hash of the other), cycle-walking back into range.
+// Stands in for a shuffled order array on huge cycles.
+typedef struct Feistel {
+	unsigned lo_bits, hi_bits;
+	uint64_t n;
+	uint64_t keys[4];
+} Feistel;
+
+static void feistel_init(Feistel *f, uint64_t n, Random64 *rng) {
+	unsigned bits = 2;
+	while (bits < 64 && (1ull << bits) < n) bits++;
+	f->hi_bits = bits / 2;
+	f->lo_bits = bits - f->hi_bits;
+	f->n = n;
+	for (int i = 0; i < 4; ++i) f->keys[i] = rng_next(rng);
+}
+
+// Round i: even rounds update the low half from the high one, odd rounds the reverse.
+// The hash is the top bits of one multiply.
+static inline uint64_t feistel_round(const Feistel *f, uint64_t x, int i) {
+	uint64_t lo_mask = (1ull << f->lo_bits) - 1;
+	uint64_t hi = x >> f->lo_bits, lo = x & lo_mask;
+	if ((i & 1) == 0) {
+		lo ^= ((hi ^ f->keys[i]) * 0x9e3779b97f4a7c15ULL) >> (64 - f->lo_bits);
+	} else {
+		hi ^= ((lo ^ f->keys[i]) * 0x9e3779b97f4a7c15ULL) >> (64 - f->hi_bits);
+	}
+	return (hi << f->lo_bits) | lo;
+}
+
+static uint64_t feistel_forward(const Feistel *f, uint64_t x) {
+	do {
+		for (int i = 0; i < 4; ++i) x = feistel_round(f, x, i);
+	} while (x >= f->n);
+	return x;
+}
+
+static uint64_t feistel_inverse(const Feistel *f, uint64_t x) {
+	do {
+		for (int i = 3; i >= 0; --i) x = feistel_round(f, x, i);
+	} while (x >= f->n);
+	return x;
+}
+
+// Link a cycle without an order array: closed-form successors for sequential and reverse,
+// a Feistel permutation for random (other patterns have no streaming form and use random).
+// Nodes are written in address order, so building a huge cycle streams through memory.
+static void build_cycle_streaming(uint8_t *base, size_t num_nodes, size_t node_stride, Random64 *rng, Pattern p, size_t ptr_offset) {
+	uint64_t t0 = now_ns();
+	Feistel f;
+	feistel_init(&f, num_nodes, rng);
+	for (size_t x = 0; x < num_nodes; ++x) {
+		size_t next;
+		if (p == PATTERN_SEQUENTIAL) {
+			next = x + 1 == num_nodes ? 0 : x + 1;
+		} else if (p == PATTERN_REVERSE) {
+			next = x == 0 ? num_nodes - 1 : x - 1;
+		} else {
+			uint64_t i = feistel_inverse(&f, x) + 1;
+			next = (size_t)feistel_forward(&f, i == num_nodes ? 0 : i);
+		}
+		void *to_ptr = (void *)(base + next * node_stride + ptr_offset);
+		memcpy(base + x * node_stride + ptr_offset, &to_ptr, sizeof(to_ptr));
+	}
+	phase_add(PHASE_BUILD, t0);
 }
 
-// Pointer-chase for given number of steps starting at head
 #if defined(__GNUC__) || defined(__clang__)
-__attribute__((noinline))
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
 #endif
-static void *chase(void *head, size_t steps) {
+
+// Pointer-chase for given number of steps starting at head
+NOINLINE static void *chase(void *head, size_t steps) {
 	void *p = head;
 	for (size_t i = 0; i < steps; ++i) {
 		p = *(void * volatile *)p; // force actual memory load
@@ -236,12 +479,617 @@ static void *chase(void *head, size_t steps) {
 	return p;
 }
 
+typedef void *(*ChaseFn)(void *head, size_t steps);
+
+// Pointer-chase where the next pointer may straddle a cache-line or page boundary
+#if defined(__GNUC__) || defined(__clang__)
+typedef void *unaligned_ptr_t __attribute__((aligned(1)));
+NOINLINE static void *chase_unaligned(void *head, size_t steps) {
+	void *p = head;
+	for (size_t i = 0; i < steps; ++i) {
+		p = *(unaligned_ptr_t volatile *)p;
+	}
+	g_sink = p;
+	return p;
+}
+#else
+NOINLINE static void *chase_unaligned(void *head, size_t steps) {
+	void *p = head;
+	for (size_t i = 0; i < steps; ++i) {
+		memcpy(&p, p, sizeof(p));
+		atomic_signal_fence(memory_order_seq_cst);
+	}
+	g_sink = p;
+	return p;
+}
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define HAVE_LOCKED_CHASE 1
+// Pointer-chase where every load is a locked RMW (lock xadd of 0) on the pointer itself.
+// With a line-straddling pointer this is a split lock.
+NOINLINE static void *chase_locked(void *head, size_t steps) {
+	void *p = head;
+	for (size_t i = 0; i < steps; ++i) {
+		uintptr_t v = 0;
+		__asm__ __volatile__("lock xaddq %0, (%1)" : "+r"(v) : "r"(p) : "memory");
+		p = (void *)v;
+	}
+	g_sink = p;
+	return p;
+}
+
+#define SPLIT_LOCK_PROBES 8
+#define SPLIT_LOCK_SLOW_NS 1000000u
+
+// Time a few split lock xadds in a forked child before the sweep: the kernel's split-lock
+// detection kills the task with SIGBUS (split_lock_detect=fatal) or throttles each one by
+// ~10 ms (warn/ratelimit). Returns NULL when safe to time, else why not.
+static const char *split_lock_probe(size_t line) {
+	fflush(stdout);
+	fflush(stderr);
+	pid_t pid = fork();
+	if (pid < 0) return "fork failed";
+	if (pid == 0) {
+		uint8_t *buf = (uint8_t *)aligned_alloc(line, 2 * line);
+		if (!buf) _exit(3);
+		uint8_t *word = buf + line - sizeof(uint32_t);
+		for (int i = 0; i < SPLIT_LOCK_PROBES; ++i) {
+			uintptr_t v = 1;
+			uint64_t t0 = now_ns();
+			__asm__ __volatile__("lock xaddq %0, (%1)" : "+r"(v) : "r"(word) : "memory");
+			if (now_ns() - t0 > SPLIT_LOCK_SLOW_NS) _exit(2);
+		}
+		_exit(0);
+	}
+	int status = 0;
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR) return "waitpid failed";
+	}
+	if (WIFSIGNALED(status)) return WTERMSIG(status) == SIGBUS ? "split locks raise SIGBUS (split_lock_detect=fatal)" : "probe child was killed";
+	if (WEXITSTATUS(status) == 2) return "split locks are throttled by the kernel (split_lock_detect=warn)";
+	if (WEXITSTATUS(status) != 0) return "probe failed";
+	return NULL;
+}
+#endif
+
+// Chase variants with a memory barrier or ordered load on every hop.
+// BARRIER runs after each load; LOAD replaces the plain volatile load.
+#define DEFINE_BARRIER_CHASE(name, LOAD, BARRIER) \
+	NOINLINE static void *name(void *head, size_t steps) { \
+		void *p = head; \
+		_Atomic unsigned long rmw_word = 0; \
+		(void)rmw_word; \
+		for (size_t i = 0; i < steps; ++i) { \
+			LOAD; \
+			BARRIER; \
+		} \
+		g_sink = p; \
+		return p; \
+	}
+
+#define PLAIN_LOAD (p = *(void * volatile *)p)
+#define ACQUIRE_LOAD (p = atomic_load_explicit((void *_Atomic *)p, memory_order_acquire))
+
+DEFINE_BARRIER_CHASE(chase_acquire, ACQUIRE_LOAD, (void)0)
+DEFINE_BARRIER_CHASE(chase_fence_seq_cst, PLAIN_LOAD, atomic_thread_fence(memory_order_seq_cst))
+DEFINE_BARRIER_CHASE(chase_fence_acq_rel, PLAIN_LOAD, atomic_thread_fence(memory_order_acq_rel))
+DEFINE_BARRIER_CHASE(chase_locked_rmw, PLAIN_LOAD, atomic_fetch_add_explicit(&rmw_word, 1ul, memory_order_seq_cst))
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+DEFINE_BARRIER_CHASE(chase_mfence, PLAIN_LOAD, __asm__ __volatile__("mfence" ::: "memory"))
+DEFINE_BARRIER_CHASE(chase_lfence, PLAIN_LOAD, __asm__ __volatile__("lfence" ::: "memory"))
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+DEFINE_BARRIER_CHASE(chase_dmb_ish, PLAIN_LOAD, __asm__ __volatile__("dmb ish" ::: "memory"))
+DEFINE_BARRIER_CHASE(chase_dmb_ishld, PLAIN_LOAD, __asm__ __volatile__("dmb ishld" ::: "memory"))
+// The explicit instructions, since the portable acquire row may already compile to either
+DEFINE_BARRIER_CHASE(chase_ldar, __asm__ __volatile__("ldar %0, [%0]" : "+r"(p) : : "memory"), (void)0)
+#if defined(__ARM_FEATURE_RCPC)
+DEFINE_BARRIER_CHASE(chase_ldapr, __asm__ __volatile__("ldapr %0, [%0]" : "+r"(p) : : "memory"), (void)0)
+#endif
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__powerpc__) || defined(__powerpc64__) || defined(__ppc__))
+DEFINE_BARRIER_CHASE(chase_sync, PLAIN_LOAD, __asm__ __volatile__("sync" ::: "memory"))
+DEFINE_BARRIER_CHASE(chase_lwsync, PLAIN_LOAD, __asm__ __volatile__("lwsync" ::: "memory"))
+DEFINE_BARRIER_CHASE(chase_isync, PLAIN_LOAD, __asm__ __volatile__("isync" ::: "memory"))
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__sparc__)
+DEFINE_BARRIER_CHASE(chase_membar, PLAIN_LOAD, __asm__ __volatile__("membar #StoreLoad" ::: "memory"))
+#endif
+
+typedef struct BarrierKind {
+	const char *name;
+	ChaseFn fn;
+} BarrierKind;
+
+// Portable C11 variants first, then the native instructions of this target
+static const BarrierKind barrier_kinds[] = {
+	{"acquire", chase_acquire},
+	{"fence_seq_cst", chase_fence_seq_cst},
+	{"fence_acq_rel", chase_fence_acq_rel},
+	{"locked_rmw", chase_locked_rmw},
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	{"mfence", chase_mfence},
+	{"lfence", chase_lfence},
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+	{"dmb_ish", chase_dmb_ish},
+	{"dmb_ishld", chase_dmb_ishld},
+	{"ldar", chase_ldar},
+#if defined(__ARM_FEATURE_RCPC)
+	{"ldapr", chase_ldapr},
+#endif
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__powerpc__) || defined(__powerpc64__) || defined(__ppc__))
+	{"sync", chase_sync},
+	{"lwsync", chase_lwsync},
+	{"isync", chase_isync},
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__sparc__)
+	{"membar_storeload", chase_membar},
+#endif
+};
+#define NUM_BARRIER_KINDS (sizeof(barrier_kinds) / sizeof(barrier_kinds[0]))
+
+// Pin the calling thread to one CPU. Returns false when pinning is unsupported or fails.
+static bool pin_to_cpu(int cpu) {
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET((size_t)cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+	(void)cpu;
+	return false;
+#endif
+}
+
+// Affinity mask of the calling thread, to put back after temporary pinning
+typedef struct AffinityMask {
+#if defined(__linux__)
+	cpu_set_t set;
+#endif
+	bool saved;
+} AffinityMask;
+
+static void affinity_save(AffinityMask *m) {
+	m->saved = false;
+#if defined(__linux__)
+	CPU_ZERO(&m->set);
+	m->saved = sched_getaffinity(0, sizeof(m->set), &m->set) == 0;
+#endif
+}
+
+static void affinity_restore(const AffinityMask *m) {
+#if defined(__linux__)
+	if (m->saved) (void)sched_setaffinity(0, sizeof(m->set), &m->set);
+#else
+	(void)m;
+#endif
+}
+
+static AffinityMask g_start_affinity;
+
+// Remember the affinity the process started with; restore_affinity() undoes later pinning
+static void save_affinity(void) {
+	affinity_save(&g_start_affinity);
+}
+
+static void restore_affinity(void) {
+	affinity_restore(&g_start_affinity);
+}
+
+// CPU the calling thread currently runs on, or -1 when unknown
+static int current_cpu(void) {
+#if defined(__linux__)
+	return sched_getcpu();
+#else
+	return -1;
+#endif
+}
+
+// L1 data cache line size as reported by the OS, 64 when unknown
+static size_t cache_line_size(void) {
+#if defined(_SC_LEVEL1_DCACHE_LINESIZE)
+	long v = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+	if (v > 0) return (size_t)v;
+#endif
+#if defined(__linux__)
+	FILE *f = fopen("/sys/devices/system/cpu/cpu0/cache/index0/coherency_line_size", "r");
+	if (f) {
+		long v2 = 0;
+		int ok = fscanf(f, "%ld", &v2);
+		fclose(f);
+		if (ok == 1 && v2 > 0) return (size_t)v2;
+	}
+#endif
+	return 64;
+}
+
+static size_t page_size(void) {
+	long v = sysconf(_SC_PAGESIZE);
+	return v > 0 ? (size_t)v : 4096;
+}
+
+#define HUGE_PAGE_BYTES ((size_t)2 << 20)
+
+// Anonymous mapping aligned to 2 MiB and advised for transparent huge pages, so physical
+// address bits match virtual ones up to the huge page size and large sweeps need fewer TLB
+// entries. reserve_only skips swap accounting for sparse use. Returns the aligned start;
+// unmap *raw / *mapped when done.
+static uint8_t *map_huge(size_t bytes, bool reserve_only, void **raw, size_t *mapped) {
+	size_t len = bytes + HUGE_PAGE_BYTES;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_NORESERVE)
+	if (reserve_only) flags |= MAP_NORESERVE;
+#else
+	(void)reserve_only;
+#endif
+	void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (p == MAP_FAILED) return NULL;
+#if defined(MADV_HUGEPAGE)
+	(void)madvise(p, len, MADV_HUGEPAGE);
+#endif
+	*raw = p;
+	*mapped = len;
+	uintptr_t a = ((uintptr_t)p + HUGE_PAGE_BYTES - 1) & ~(uintptr_t)(HUGE_PAGE_BYTES - 1);
+	return (uint8_t *)a;
+}
+
+// Parse a Linux-style CPU list ("0-3,8,10-11") into out; returns the number of entries
+static size_t parse_cpu_list(const char *s, int *out, size_t cap) {
+	size_t n = 0;
+	const char *p = s;
+	while (*p) {
+		char *end = NULL;
+		long lo = strtol(p, &end, 10);
+		if (end == p) break;
+		long hi = lo;
+		p = end;
+		if (*p == '-') {
+			hi = strtol(p + 1, &end, 10);
+			p = end;
+		}
+		for (long c = lo; c <= hi && n < cap; ++c) out[n++] = (int)c;
+		while (*p == ',' || *p == ' ' || *p == '\n') p++;
+	}
+	return n;
+}
+
+// Read a small integer from a sysfs-style file; returns fallback when missing
+static long read_long_file(const char *path, long fallback) {
+	FILE *f = fopen(path, "r");
+	if (!f) return fallback;
+	long v = fallback;
+	if (fscanf(f, "%ld", &v) != 1) v = fallback;
+	fclose(f);
+	return v;
+}
+
+// Where a CPU sits in the machine, as far as sharing caches is concerned
+typedef struct CpuInfo {
+	int cpu;
+	int core;    // physical core id (SMT siblings share it)
+	int package; // socket
+	int l3;      // lowest CPU sharing this CPU's last-level cache, -1 when unknown
+	int l2;      // lowest CPU sharing this CPU's L2, -1 when unknown
+} CpuInfo;
+
+#define MAX_CPUS 1024
+
+// Enumerate the CPUs this process may run on with their core/package/L3 placement.
+static size_t read_topology(CpuInfo *out, size_t cap) {
+	size_t n = 0;
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) != 0) return 0;
+	for (int cpu = 0; cpu < CPU_SETSIZE && n < cap; ++cpu) {
+		if (!CPU_ISSET((size_t)cpu, &set)) continue;
+		char path[256];
+		CpuInfo ci;
+		ci.cpu = cpu;
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+		ci.core = (int)read_long_file(path, cpu);
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+		ci.package = (int)read_long_file(path, 0);
+		ci.l3 = -1;
+		ci.l2 = -1;
+		for (int idx = 0; idx < 8; ++idx) {
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, idx);
+			long level = read_long_file(path, -1);
+			if (level < 0) break;
+			if (level != 2 && level != 3) continue;
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, idx);
+			FILE *f = fopen(path, "r");
+			if (f) {
+				char line[1024];
+				int first[1];
+				if (fgets(line, sizeof(line), f) && parse_cpu_list(line, first, 1) == 1) {
+					if (level == 3) ci.l3 = first[0];
+					else ci.l2 = first[0];
+				}
+				fclose(f);
+			}
+		}
+		out[n++] = ci;
+	}
+#else
+	long online = sysconf(_SC_NPROCESSORS_ONLN);
+	for (long cpu = 0; cpu < online && n < cap; ++cpu) {
+		CpuInfo ci = {(int)cpu, (int)cpu, 0, -1, -1};
+		out[n++] = ci;
+	}
+#endif
+	return n;
+}
+
+// Data/unified cache sizes of one CPU from sysfs, indexed by level - 1.
+// Returns the number of levels found (0 when sysfs is unavailable).
+static size_t read_sysfs_cache_sizes(int cpu, size_t *sizes, size_t cap) {
+	size_t levels = 0;
+	for (size_t i = 0; i < cap; ++i) sizes[i] = 0;
+#if defined(__linux__)
+	if (cpu < 0) cpu = 0;
+	for (int idx = 0; idx < 16; ++idx) {
+		char path[256];
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, idx);
+		long level = read_long_file(path, -1);
+		if (level < 0) break;
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/type", cpu, idx);
+		FILE *f = fopen(path, "r");
+		char type[32] = "";
+		if (f) {
+			if (!fgets(type, sizeof(type), f)) type[0] = '\0';
+			fclose(f);
+		}
+		if (strncmp(type, "Instruction", 11) == 0) continue;
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/size", cpu, idx);
+		f = fopen(path, "r");
+		if (!f) continue;
+		unsigned long long v = 0;
+		char unit = 0;
+		int got = fscanf(f, "%llu%c", &v, &unit);
+		fclose(f);
+		if (got < 1 || level < 1 || (size_t)level > cap) continue;
+		if (unit == 'K') v <<= 10;
+		else if (unit == 'M') v <<= 20;
+		else if (unit == 'G') v <<= 30;
+		sizes[level - 1] = (size_t)v;
+		if ((size_t)level > levels) levels = (size_t)level;
+	}
+#else
+	(void)cpu;
+#endif
+	return levels;
+}
+
+// Thread placements relative to the first usable CPU, ordered by topology distance
+typedef enum Placement {
+	PLACEMENT_SMT = 0,   // SMT siblings of one core
+	PLACEMENT_SAME_L3,   // distinct cores sharing one L3
+	PLACEMENT_CROSS_L3,  // one core per L3 domain within a package
+	PLACEMENT_CROSS_SOCKET, // one core per package
+	PLACEMENT_COUNT
+} Placement;
+
+static const char *placement_name(Placement p) {
+	switch (p) {
+		case PLACEMENT_SMT: return "smt";
+		case PLACEMENT_SAME_L3: return "same-l3";
+		case PLACEMENT_CROSS_L3: return "cross-l3";
+		case PLACEMENT_CROSS_SOCKET: return "cross-socket";
+		default: return "?";
+	}
+}
+
+// Pick CPUs for a placement starting from topo[0]; returns how many were found
+static size_t placement_cpus(const CpuInfo *topo, size_t n, Placement p, int *out, size_t cap) {
+	if (n == 0 || cap == 0) return 0;
+	const CpuInfo *first = &topo[0];
+	size_t count = 0;
+	out[count++] = first->cpu;
+	for (size_t i = 1; i < n && count < cap; ++i) {
+		const CpuInfo *c = &topo[i];
+		bool take = false;
+		bool distinct = true;
+		for (size_t k = 0; k < count; ++k) {
+			const CpuInfo *o = NULL;
+			for (size_t t = 0; t < n; ++t) if (topo[t].cpu == out[k]) o = &topo[t];
+			if (!o) continue;
+			switch (p) {
+				case PLACEMENT_SMT: break;
+				case PLACEMENT_SAME_L3: if (o->core == c->core && o->package == c->package) distinct = false; break;
+				case PLACEMENT_CROSS_L3: if (o->l3 == c->l3) distinct = false; break;
+				case PLACEMENT_CROSS_SOCKET: if (o->package == c->package) distinct = false; break;
+				default: break;
+			}
+		}
+		switch (p) {
+			case PLACEMENT_SMT: take = c->core == first->core && c->package == first->package; break;
+			case PLACEMENT_SAME_L3: take = distinct && c->package == first->package && c->l3 == first->l3; break;
+			case PLACEMENT_CROSS_L3: take = distinct && c->package == first->package && c->l3 >= 0; break;
+			case PLACEMENT_CROSS_SOCKET: take = distinct; break;
+			default: break;
+		}
+		if (take) out[count++] = c->cpu;
+	}
+	return count;
+}
+
+// Spin-wait hint for busy loops
+static inline void cpu_relax(void) {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	__asm__ __volatile__("pause");
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+// Disturbances observed while a timed chase() was running
+typedef struct NoiseCounts {
+	uint64_t ctx_switches; // voluntary + involuntary
+	uint64_t page_faults;  // minor + major
+	uint64_t interrupts;   // non-timer interrupts on the measured CPU
+	uint64_t steal_ticks;  // hypervisor steal time on the measured CPU (USER_HZ ticks)
+	unsigned rejected;     // timed runs discarded and retried because of the above
+} NoiseCounts;
+
+typedef struct NoiseSnapshot {
+	uint64_t ctx_switches;
+	uint64_t page_faults;
+	uint64_t interrupts;
+	uint64_t steal_ticks;
+} NoiseSnapshot;
+
+// Sum all non-timer interrupt counts for the given CPU from /proc/interrupts.
+// Local timer ticks fire regardless of load, so they are not a disturbance signal.
+static uint64_t read_cpu_interrupts(int cpu) {
+	uint64_t total = 0;
+#if defined(__linux__)
+	if (cpu < 0) return 0;
+	FILE *f = fopen("/proc/interrupts", "r");
+	if (!f) return 0;
+	char *line = NULL;
+	size_t cap = 0;
+	// header lists online CPUs ("CPU0 CPU1 ..."); map our CPU to its column
+	int column = -1;
+	int ncols = 0;
+	if (getline(&line, &cap, f) > 0) {
+		for (char *tok = strtok(line, " \t\n"); tok; tok = strtok(NULL, " \t\n")) {
+			if (strncmp(tok, "CPU", 3) == 0 && atoi(tok + 3) == cpu) column = ncols;
+			ncols++;
+		}
+	}
+	while (column >= 0 && getline(&line, &cap, f) > 0) {
+		char *p = strchr(line, ':');
+		if (!p) continue;
+		if (strstr(p, "timer") != NULL || strstr(p, "Timer") != NULL) continue;
+		p++;
+		for (int c = 0; c <= column; ++c) {
+			char *end = NULL;
+			unsigned long long v = strtoull(p, &end, 10);
+			if (end == p) break; // short row (ERR/MIS)
+			if (c == column) total += (uint64_t)v;
+			p = end;
+		}
+	}
+	free(line);
+	fclose(f);
+#else
+	(void)cpu;
+#endif
+	return total;
+}
+
+// Steal ticks for the given CPU from /proc/stat (8th counter of the cpuN line)
+static uint64_t read_cpu_steal(int cpu) {
+	uint64_t steal = 0;
+#if defined(__linux__)
+	if (cpu < 0) return 0;
+	FILE *f = fopen("/proc/stat", "r");
+	if (!f) return 0;
+	char line[512];
+	char want[32];
+	snprintf(want, sizeof(want), "cpu%d ", cpu);
+	while (fgets(line, sizeof(line), f)) {
+		if (strncmp(line, want, strlen(want)) != 0) continue;
+		unsigned long long v[8] = {0};
+		if (sscanf(line + strlen(want), "%llu %llu %llu %llu %llu %llu %llu %llu",
+				&v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]) == 8) {
+			steal = (uint64_t)v[7];
+		}
+		break;
+	}
+	fclose(f);
+#else
+	(void)cpu;
+#endif
+	return steal;
+}
+
+static void noise_rusage(NoiseSnapshot *s) {
+	struct rusage ru;
+#if defined(RUSAGE_THREAD)
+	getrusage(RUSAGE_THREAD, &ru);
+#else
+	getrusage(RUSAGE_SELF, &ru);
+#endif
+	s->ctx_switches = (uint64_t)ru.ru_nvcsw + (uint64_t)ru.ru_nivcsw;
+	s->page_faults = (uint64_t)ru.ru_minflt + (uint64_t)ru.ru_majflt;
+}
+
+// Snapshot before a timed region: /proc reads first so their own faults are not counted
+static void noise_begin(NoiseSnapshot *s, int cpu) {
+	s->interrupts = read_cpu_interrupts(cpu);
+	s->steal_ticks = read_cpu_steal(cpu);
+	noise_rusage(s);
+}
+
+// Snapshot after a timed region and return the deltas: rusage first, /proc reads last
+static NoiseCounts noise_end(const NoiseSnapshot *begin, int cpu) {
+	NoiseSnapshot e;
+	noise_rusage(&e);
+	e.interrupts = read_cpu_interrupts(cpu);
+	e.steal_ticks = read_cpu_steal(cpu);
+	NoiseCounts d = {0};
+	d.ctx_switches = e.ctx_switches - begin->ctx_switches;
+	d.page_faults = e.page_faults - begin->page_faults;
+	d.interrupts = e.interrupts >= begin->interrupts ? e.interrupts - begin->interrupts : 0;
+	d.steal_ticks = e.steal_ticks >= begin->steal_ticks ? e.steal_ticks - begin->steal_ticks : 0;
+	return d;
+}
+
+static bool noise_disturbed(const NoiseCounts *d, unsigned irq_max) {
+	return d->ctx_switches > 0 || d->page_faults > 0 || d->steal_ticks > 0 || d->interrupts > irq_max;
+}
+
+static void noise_accumulate(NoiseCounts *acc, const NoiseCounts *d) {
+	acc->ctx_switches += d->ctx_switches;
+	acc->page_faults += d->page_faults;
+	acc->interrupts += d->interrupts;
+	acc->steal_ticks += d->steal_ticks;
+}
+
 typedef struct Sample {
 	size_t working_set_bytes;
 	double ns_per_access;
+	NoiseCounts noise;
+	double energy_nj[ENERGY_DOMAINS]; // per access, with --energy
 } Sample;
 
+typedef enum Mode {
+	MODE_LATENCY = 0, // latency vs working-set size sweep (default)
+	MODE_FENCE,       // added cost of barriers / ordered loads per hop
+	MODE_LOCKS,       // lock handoff latency and throughput by placement
+	MODE_FALSE_SHARING, // counter throughput vs separation between two threads
+	MODE_GATHER,      // SIMD gather vs scalar multi-chain chase
+	MODE_SPLIT,       // cache-line-split / page-split load penalty
+	MODE_MEMCPY,      // copy strategy throughput per size and cache state
+	MODE_ZERO,        // zeroing primitive throughput and cache pollution
+	MODE_TILE,        // blocking-factor advisor validated with tiled kernels
+	MODE_INCLUSION,   // L3 inclusion policy and effective L2+L3 capacity
+	MODE_REPLACEMENT, // per-level replacement policy from same-set access sequences
+	MODE_SELFBENCH,   // ns per node of the tool's own building blocks vs a baseline
+	MODE_POLLUTION,   // lines evicted from a warm set by syscalls, reads, context switches, signals
+	MODE_IO,          // file read throughput: read(), mmap + madvise, O_DIRECT; hot and cold cache
+	MODE_SCAN,        // survival of a hot set under an interleaved or co-running streaming scan
+	MODE_HANDOFF,     // producer/consumer buffer handoff bandwidth for every CPU pair
+	MODE_AMAC         // G interleaved lookups of depth D (coroutines + prefetch) per size
+} Mode;
+
+// Where the next pointer sits inside each node
+typedef enum SplitKind {
+	SPLIT_NONE = 0, // aligned at the start of the node
+	SPLIT_LINE,     // straddles the first cache-line boundary of the node
+	SPLIT_PAGE      // straddles a page boundary (node stride rounded up to whole pages)
+} SplitKind;
+
+// How --layouts places the extra layouts of each size
+typedef enum LayoutMode {
+	LAYOUT_FAST = 0, // same order re-linked at another buffer offset
+	LAYOUT_FULL,     // new shuffle at another buffer offset
+	LAYOUT_MMAP      // new shuffle in a freshly mapped region
+} LayoutMode;
+
+#define MAX_CPU_LIST 256
+
 typedef struct Options {
+	Mode mode;
 	size_t min_bytes;
 	size_t max_bytes;
 	size_t node_stride;
@@ -251,6 +1099,33 @@ typedef struct Options {
 	bool print_table;
 	Pattern pattern;
 	size_t pattern_arg; // e.g. stride step for PATTERN_STRIDE
+	int cpu;            // CPU to pin to, -1 = leave to the scheduler
+	bool json;          // emit JSON lines instead of the text table
+	bool reject_noisy;  // instrument timed runs and retry disturbed ones
+	unsigned noise_retries; // retries per sample before accepting a disturbed run
+	unsigned noise_irq_max; // non-timer interrupts tolerated per timed run
+	int cpus[MAX_CPU_LIST]; // explicit CPU list for threaded modes (overrides placements)
+	size_t num_cpus;
+	unsigned max_threads;   // upper bound of thread-count sweeps
+	SplitKind split;        // pointer placement for the latency sweep
+	size_t line_size;       // cache line size used for split placement
+	bool split_lock;        // also time split-lock atomics in split mode (x86-64)
+	size_t hot_bytes;       // hot working set chased to observe pollution
+	size_t disturb_bytes;   // read size and partner working set in pollution mode
+	const char *io_dir;     // directory for the io mode's test file (tmpfs or disk)
+	size_t io_bytes;        // size of that file
+	size_t cache_sizes[8];  // known cache level sizes (skip detection when given)
+	size_t num_cache_sizes;
+	const char *header_path; // write a C header with the measured parameters
+	const char *config_path; // write the same values as key=value runtime config
+	const char *plan_path;   // run the experiments listed in this file instead
+	const char *cgroup_root; // cgroup filesystem mount (limits size the buffer and timing)
+	unsigned layouts;        // physical layouts averaged per latency sample
+	LayoutMode layout_mode;
+	const char *bench_baseline; // selfbench results to compare against (written when missing)
+	bool energy;                // sample RAPL energy around timed regions
+	unsigned parallel;          // idle cores sharing the latency sweep's private-level sizes
+	const char *powercap_root;  // powercap sysfs class directory
 } Options;
 
 static size_t clamp_size(size_t v, size_t lo, size_t hi) {
@@ -272,6 +1147,60 @@ static const char *pattern_name(Pattern p) {
 	}
 }
 
+static const char *layout_mode_name(LayoutMode m) {
+	switch (m) {
+		case LAYOUT_FULL: return "full";
+		case LAYOUT_MMAP: return "mmap";
+		case LAYOUT_FAST:
+		default: return "fast";
+	}
+}
+
+static const char *mode_name(Mode m) {
+	switch (m) {
+		case MODE_LATENCY: return "latency";
+		case MODE_FENCE: return "fence";
+		case MODE_LOCKS: return "locks";
+		case MODE_FALSE_SHARING: return "falseshare";
+		case MODE_GATHER: return "gather";
+		case MODE_SPLIT: return "split";
+		case MODE_MEMCPY: return "memcpy";
+		case MODE_ZERO: return "zero";
+		case MODE_TILE: return "tile";
+		case MODE_INCLUSION: return "inclusion";
+		case MODE_REPLACEMENT: return "replacement";
+		case MODE_SELFBENCH: return "selfbench";
+		case MODE_POLLUTION: return "pollution";
+		case MODE_IO: return "io";
+		case MODE_SCAN: return "scan";
+		case MODE_HANDOFF: return "handoff";
+		case MODE_AMAC: return "amac";
+		default: return "latency";
+	}
+}
+
+static Mode parse_mode(const char *s) {
+	if (strcmp(s, "latency") == 0) return MODE_LATENCY;
+	if (strcmp(s, "fence") == 0 || strcmp(s, "barrier") == 0) return MODE_FENCE;
+	if (strcmp(s, "locks") == 0 || strcmp(s, "lock") == 0) return MODE_LOCKS;
+	if (strcmp(s, "falseshare") == 0 || strcmp(s, "false-sharing") == 0) return MODE_FALSE_SHARING;
+	if (strcmp(s, "gather") == 0) return MODE_GATHER;
+	if (strcmp(s, "split") == 0) return MODE_SPLIT;
+	if (strcmp(s, "memcpy") == 0 || strcmp(s, "copy") == 0) return MODE_MEMCPY;
+	if (strcmp(s, "zero") == 0 || strcmp(s, "memset") == 0) return MODE_ZERO;
+	if (strcmp(s, "tile") == 0 || strcmp(s, "advisor") == 0) return MODE_TILE;
+	if (strcmp(s, "inclusion") == 0 || strcmp(s, "inclusive") == 0) return MODE_INCLUSION;
+	if (strcmp(s, "replacement") == 0 || strcmp(s, "policy") == 0) return MODE_REPLACEMENT;
+	if (strcmp(s, "selfbench") == 0 || strcmp(s, "bench") == 0) return MODE_SELFBENCH;
+	if (strcmp(s, "pollution") == 0 || strcmp(s, "disturb") == 0) return MODE_POLLUTION;
+	if (strcmp(s, "io") == 0 || strcmp(s, "file") == 0) return MODE_IO;
+	if (strcmp(s, "scan") == 0 || strcmp(s, "scan-resistance") == 0) return MODE_SCAN;
+	if (strcmp(s, "handoff") == 0 || strcmp(s, "c2c") == 0) return MODE_HANDOFF;
+	if (strcmp(s, "amac") == 0 || strcmp(s, "lookups") == 0) return MODE_AMAC;
+	fprintf(stderr, "Unknown mode '%s'; using latency.\n", s);
+	return MODE_LATENCY;
+}
+
 static Pattern parse_pattern(const char *s) {
 	if (strcmp(s, "random") == 0) return PATTERN_RANDOM;
 	if (strcmp(s, "seq") == 0 || strcmp(s, "sequential") == 0) return PATTERN_SEQUENTIAL;
@@ -283,8 +1212,9 @@ static Pattern parse_pattern(const char *s) {
 	return PATTERN_RANDOM;
 }
 
-static void parse_args(int argc, char **argv, Options *opt) {
+static void default_options(Options *opt) {
 	// defaults chosen for portability across 32/64-bit
+	opt->mode = MODE_LATENCY;
 	opt->min_bytes = 4 * 1024;
 	opt->max_bytes = 256 * 1024 * 1024ull;
 	opt->node_stride = 256; // ensure > typical cache line on all targets
@@ -294,8 +1224,41 @@ static void parse_args(int argc, char **argv, Options *opt) {
 	opt->print_table = true;
 	opt->pattern = PATTERN_RANDOM;
 	opt->pattern_arg = 1;
+	opt->cpu = -1;
+	opt->json = false;
+	opt->reject_noisy = false;
+	opt->noise_retries = 3;
+	opt->noise_irq_max = 2;
+	opt->num_cpus = 0;
+	opt->max_threads = 64;
+	opt->split = SPLIT_NONE;
+	opt->line_size = 0; // detect
+	opt->split_lock = false;
+	opt->hot_bytes = 256 * 1024;
+	opt->disturb_bytes = 64 * 1024;
+	opt->io_dir = "/tmp";
+	opt->io_bytes = 128 * 1024 * 1024;
+	opt->num_cache_sizes = 0;
+	opt->header_path = NULL;
+	opt->config_path = NULL;
+	opt->plan_path = NULL;
+	opt->cgroup_root = "/sys/fs/cgroup";
+	opt->layouts = 1;
+	opt->layout_mode = LAYOUT_FAST;
+	opt->bench_baseline = NULL;
+	opt->energy = false;
+	opt->parallel = 1;
+	opt->powercap_root = "/sys/class/powercap";
+}
+
+// Apply command-line style arguments (argv[0] is skipped) on top of opt. In a plan line
+// (in_plan) -h/--help is invalid like any unknown option rather than printing and exiting,
+// and --json is ignored so every record of the plan uses the command line's format.
+static void apply_args(int argc, char **argv, Options *opt, bool in_plan) {
 	for (int i = 1; i < argc; ++i) {
-		if (strcmp(argv[i], "--min-bytes") == 0 && i + 1 < argc) {
+		if ((strcmp(argv[i], "--mode") == 0 || strcmp(argv[i], "-m") == 0) && i + 1 < argc) {
+			opt->mode = parse_mode(argv[++i]);
+		} else if (strcmp(argv[i], "--min-bytes") == 0 && i + 1 < argc) {
 			unsigned long long v = strtoull(argv[++i], NULL, 0);
 			if (v > (unsigned long long)SIZE_MAX) v = (unsigned long long)SIZE_MAX; // avoid 32-bit wrap
 			opt->min_bytes = (size_t)v;
@@ -315,17 +1278,108 @@ static void parse_args(int argc, char **argv, Options *opt) {
 			opt->pattern_arg = (size_t)strtoull(argv[++i], NULL, 0);
 		} else if (strcmp(argv[i], "--no-table") == 0) {
 			opt->print_table = false;
-		} else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
-			printf("Usage: %s [--min-bytes N] [--max-bytes N] [--node-stride N] [--target-ms N] [--repeats N] [--pattern NAME] [--pattern-arg N] [--no-table]\n", argv[0]);
+		} else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+			opt->cpu = (int)strtol(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--cpus") == 0 && i + 1 < argc) {
+			opt->num_cpus = parse_cpu_list(argv[++i], opt->cpus, MAX_CPU_LIST);
+		} else if (strcmp(argv[i], "--max-threads") == 0 && i + 1 < argc) {
+			opt->max_threads = (unsigned)strtoul(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--split") == 0 && i + 1 < argc) {
+			const char *v = argv[++i];
+			opt->split = strcmp(v, "line") == 0 ? SPLIT_LINE : (strcmp(v, "page") == 0 ? SPLIT_PAGE : SPLIT_NONE);
+		} else if (strcmp(argv[i], "--line-size") == 0 && i + 1 < argc) {
+			opt->line_size = (size_t)strtoull(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--split-lock") == 0) {
+			opt->split_lock = true;
+		} else if (strcmp(argv[i], "--cache-sizes") == 0 && i + 1 < argc) {
+			char *p = argv[++i];
+			opt->num_cache_sizes = 0;
+			while (*p && opt->num_cache_sizes < 8) {
+				char *end = NULL;
+				unsigned long long v = strtoull(p, &end, 0);
+				if (end == p) break;
+				opt->cache_sizes[opt->num_cache_sizes++] = (size_t)v;
+				p = (*end == ',') ? end + 1 : end;
+			}
+		} else if (strcmp(argv[i], "--emit-header") == 0 && i + 1 < argc) {
+			opt->header_path = argv[++i];
+		} else if (strcmp(argv[i], "--emit-config") == 0 && i + 1 < argc) {
+			opt->config_path = argv[++i];
+		} else if (strcmp(argv[i], "--plan") == 0 && i + 1 < argc) {
+			opt->plan_path = argv[++i];
+		} else if (strcmp(argv[i], "--cgroup-root") == 0 && i + 1 < argc) {
+			opt->cgroup_root = argv[++i];
+		} else if (strcmp(argv[i], "--parallel") == 0 && i + 1 < argc) {
+			opt->parallel = (unsigned)strtoul(argv[++i], NULL, 0);
+			if (opt->parallel == 0) opt->parallel = 1;
+		} else if (strcmp(argv[i], "--energy") == 0) {
+			opt->energy = true;
+		} else if (strcmp(argv[i], "--powercap-root") == 0 && i + 1 < argc) {
+			opt->powercap_root = argv[++i];
+		} else if (strcmp(argv[i], "--bench-baseline") == 0 && i + 1 < argc) {
+			opt->bench_baseline = argv[++i];
+		} else if (strcmp(argv[i], "--layouts") == 0 && i + 1 < argc) {
+			opt->layouts = (unsigned)strtoul(argv[++i], NULL, 0);
+			if (opt->layouts == 0) opt->layouts = 1;
+		} else if (strcmp(argv[i], "--layout-mode") == 0 && i + 1 < argc) {
+			const char *v = argv[++i];
+			opt->layout_mode = strcmp(v, "full") == 0 ? LAYOUT_FULL : (strcmp(v, "mmap") == 0 ? LAYOUT_MMAP : LAYOUT_FAST);
+		} else if (strcmp(argv[i], "--hot-bytes") == 0 && i + 1 < argc) {
+			opt->hot_bytes = (size_t)strtoull(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--disturb-bytes") == 0 && i + 1 < argc) {
+			opt->disturb_bytes = (size_t)strtoull(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--io-dir") == 0 && i + 1 < argc) {
+			opt->io_dir = argv[++i];
+		} else if (strcmp(argv[i], "--io-bytes") == 0 && i + 1 < argc) {
+			opt->io_bytes = (size_t)strtoull(argv[++i], NULL, 0);
+		} else if (in_plan && strcmp(argv[i], "--json") == 0) {
+			fprintf(stderr, "Ignoring '--json' in a plan line; output format applies to the whole plan, set it on the command line\n");
+		} else if (strcmp(argv[i], "--json") == 0) {
+			opt->json = true;
+		} else if (strcmp(argv[i], "--reject-noisy") == 0) {
+			opt->reject_noisy = true;
+		} else if (strcmp(argv[i], "--noise-retries") == 0 && i + 1 < argc) {
+			opt->noise_retries = (unsigned)strtoul(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--noise-irq-max") == 0 && i + 1 < argc) {
+			opt->noise_irq_max = (unsigned)strtoul(argv[++i], NULL, 0);
+		} else if (!in_plan && (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)) {
+			printf("Usage: %s [--mode NAME] [--min-bytes N] [--max-bytes N] [--node-stride N] [--target-ms N] [--repeats N] [--pattern NAME] [--pattern-arg N] [--no-table]\n", argv[0]);
+			printf("       [--cpu N] [--cpus LIST] [--max-threads N] [--json] [--reject-noisy] [--noise-retries N] [--noise-irq-max N]\n");
+			printf("       [--split none|line|page] [--line-size N] [--split-lock] [--hot-bytes N] [--disturb-bytes N] [--cache-sizes L1,L2,...]\n");
+			printf("       [--emit-header FILE] [--emit-config FILE] [--plan FILE] [--cgroup-root DIR]\n");
+			printf("       [--layouts K] [--layout-mode fast|full|mmap] [--bench-baseline FILE] [--energy] [--powercap-root DIR]\n");
+			printf("       [--io-dir DIR] [--io-bytes N] [--parallel K]\n");
+			printf("  Modes: latency (default), fence, locks, falseshare, gather, split, memcpy, zero, tile, inclusion, replacement, selfbench, pollution, io, scan, handoff, amac\n");
 			printf("  Patterns: random (default), seq, reverse, stride, interleave, gray, bitrev\n");
 			printf("  For stride pattern, use --pattern-arg K to set step (default 1).\n");
+			printf("  --plan FILE runs one experiment per line (same options, applied on top of the\n");
+			printf("  command line) in a single process sharing one prefaulted buffer.\n");
+			printf("  --reject-noisy retries timed runs disturbed by context switches, page faults,\n");
+			printf("  steal time or more than --noise-irq-max non-timer interrupts (default 2).\n");
 			exit(0);
+		} else {
+			fprintf(stderr, "Ignoring unknown or incomplete option '%s'\n", argv[i]);
 		}
 	}
-	// sanity bounds
-	opt->min_bytes = clamp_size(opt->min_bytes, opt->node_stride * 2, opt->max_bytes);
-	// Clamp upper bound to 4 GiB, but cap at SIZE_MAX to avoid 32-bit wrap
-	uint64_t hi64 = 4ull * 1024 * 1024 * 1024;
+}
+
+// Sanity bounds once all arguments are in
+static void finalize_options(Options *opt) {
+	if (opt->line_size == 0) opt->line_size = cache_line_size();
+	if (opt->split == SPLIT_LINE && opt->node_stride < opt->line_size + sizeof(void *)) {
+		opt->node_stride = opt->line_size * 2;
+		fprintf(stderr, "--split line needs node_stride > line size; using %zu\n", opt->node_stride);
+	}
+	if (opt->split == SPLIT_PAGE && opt->node_stride % page_size() != 0) {
+		opt->node_stride = (opt->node_stride + page_size() - 1) / page_size() * page_size();
+		fprintf(stderr, "--split page needs whole-page nodes; using node_stride %zu\n", opt->node_stride);
+	}
+	// two nodes, plus room for a page-split pointer to run past the second one
+	size_t min_lo = opt->node_stride * 2 + (opt->split == SPLIT_PAGE ? page_size() : 0);
+	opt->min_bytes = clamp_size(opt->min_bytes, min_lo, opt->max_bytes);
+	// Clamp upper bound to 512 GiB (big-memory hosts, memory-side caches), but cap at SIZE_MAX
+	// to avoid 32-bit wrap
+	uint64_t hi64 = 512ull * 1024 * 1024 * 1024;
 	size_t hi = (hi64 > (uint64_t)SIZE_MAX) ? SIZE_MAX : (size_t)hi64;
 	opt->max_bytes = clamp_size(opt->max_bytes, opt->min_bytes, hi);
 }
@@ -353,9 +1407,9 @@ static size_t generate_sizes(size_t min_bytes, size_t max_bytes, size_t *out, si
 		if (p >= min_bytes) {
 			if (count < out_cap) out[count++] = p;
 		}
-		// Always add 1.5x
+		// Add 1.5x up to 4 GiB; beyond that each size costs seconds, powers of two suffice
 		size_t v15 = p + p / 2;
-		if (v15 >= min_bytes && v15 <= max_bytes) {
+		if (v15 >= min_bytes && v15 <= max_bytes && (uint64_t)p < (4ull << 30)) {
 			if (count < out_cap) out[count++] = v15;
 		}
 		// For smaller sizes, add denser steps
@@ -394,21 +1448,31 @@ static size_t generate_sizes(size_t min_bytes, size_t max_bytes, size_t *out, si
 	return count;
 }
 
-// Measure ns per pointer-chase access for a given working set size
-static double measure_ns_per_access(uint8_t *base, size_t working_set_bytes, size_t node_stride, size_t *perm, Random64 *rng, const Options *opt) {
-	// number of nodes
-	size_t nodes = working_set_bytes / node_stride;
-	if (nodes < 2) nodes = 2; // minimal cycle
-	build_cycle_pattern(base, nodes, node_stride, perm, rng, opt->pattern, opt->pattern_arg);
-	void *head = (void *)base;
+static bool energy_on(const Options *opt) {
+	return opt->energy && g_rapl_count > 0;
+}
+
+// Cycles above this many nodes are sampled instead of traversed over and over: warmup is one
+// bounded stretch, calibration starts from a fixed step count, and every run continues where
+// the previous one stopped so successive runs still cover the whole cycle.
+#define CHASE_BOUNDED_NODES ((size_t)1 << 24)
+
+// Time fn over an already-built cycle: warmup, adaptive run length, best of opt->repeats.
+// When noise is non-NULL and opt->reject_noisy is set, each timed chase is instrumented,
+// disturbed runs are retried (up to opt->noise_retries per sample) and counts are reported.
+static double time_chase(ChaseFn fn, void *head, size_t nodes, const Options *opt, NoiseCounts *noise) {
+	bool bounded = nodes > CHASE_BOUNDED_NODES;
 	// warmup
-	for (unsigned w = 0; w < opt->warmup_iters; ++w) {
-		(void)chase(head, nodes);
+	unsigned warmup_iters = bounded ? 1 : opt->warmup_iters;
+	uint64_t tw = now_ns();
+	for (unsigned w = 0; w < warmup_iters; ++w) {
+		head = fn(head, bounded ? CHASE_BOUNDED_NODES : nodes);
 	}
+	phase_add(PHASE_WARMUP, tw);
 	// adaptive run length to hit ~target_ms
 	uint64_t target_ns = (uint64_t)opt->target_ms * 1000000ull;
 	// Start with a few passes
-	uint64_t steps = nodes * 16ull;
+	uint64_t steps = bounded ? (1ull << 20) : nodes * 16ull;
 	if (steps < 1000ull) steps = 1000ull;
 	double best_ns_per = 1e300;
 	for (unsigned r = 0; r < opt->repeats; ++r) {
@@ -416,18 +1480,39 @@ static double measure_ns_per_access(uint8_t *base, size_t working_set_bytes, siz
 		for (;;) {
 			atomic_signal_fence(memory_order_seq_cst);
 			uint64_t t0 = now_ns();
-			(void)chase(head, (size_t)steps);
+			head = fn(head, (size_t)steps);
 			uint64_t t1 = now_ns();
 			atomic_signal_fence(memory_order_seq_cst);
 			uint64_t dt = t1 - t0;
+			g_phase_ns[PHASE_CALIBRATE] += dt;
 			if (dt >= target_ns / 2 || steps > (1ull << 62)) break;
 			steps *= 2;
 		}
+		bool instrument = noise != NULL && opt->reject_noisy;
+		int cpu = instrument ? (opt->cpu >= 0 ? opt->cpu : current_cpu()) : -1;
+		NoiseSnapshot snap = {0};
+		NoiseCounts d = {0};
+		bool energy = energy_on(opt);
+		uint64_t e0[MAX_RAPL_ZONES], e1[MAX_RAPL_ZONES];
+		if (instrument) noise_begin(&snap, cpu);
+		if (energy) energy_read(e0);
 		atomic_signal_fence(memory_order_seq_cst);
 		uint64_t t0 = now_ns();
-		(void)chase(head, (size_t)steps);
+		head = fn(head, (size_t)steps);
 		uint64_t t1 = now_ns();
 		atomic_signal_fence(memory_order_seq_cst);
+		if (energy) energy_read(e1);
+		g_phase_ns[PHASE_TIMED] += t1 - t0;
+		if (instrument) {
+			d = noise_end(&snap, cpu);
+			if (noise_disturbed(&d, opt->noise_irq_max) && noise->rejected < opt->noise_retries) {
+				noise->rejected++;
+				r--; // retry this repeat
+				continue;
+			}
+			noise_accumulate(noise, &d);
+		}
+		if (energy) energy_add(e0, e1, (double)steps);
 		uint64_t dt = t1 - t0;
 		double ns_per = (double)dt / (double)steps;
 		if (ns_per < best_ns_per) best_ns_per = ns_per; // take best of repeats to reduce noise
@@ -435,27 +1520,157 @@ static double measure_ns_per_access(uint8_t *base, size_t working_set_bytes, siz
 	return best_ns_per;
 }
 
-// Heuristic: detect boundaries where latency jumps vs previous plateau
-typedef struct Boundary {
-	size_t approx_size_bytes;
-	double ratio;
-} Boundary;
+// Number of nodes used for a working set (at least a minimal 2-node cycle)
+static size_t nodes_for_size(size_t working_set_bytes, size_t node_stride) {
+	size_t nodes = working_set_bytes / node_stride;
+	return nodes < 2 ? 2 : nodes;
+}
 
-static size_t detect_boundaries(const Sample *samples, size_t n, Boundary *out, size_t out_cap) {
-	if (n == 0) return 0;
-	double plateau_sum = samples[0].ns_per_access;
-	int plateau_count = 1;
-	double plateau_avg = plateau_sum / plateau_count;
-	const double jump_threshold = 1.25; // 25% jump
-	const int min_plateau_points = 2;
-	size_t last_boundary_idx = 0;
-	size_t found = 0;
-	for (size_t i = 1; i < n; ++i) {
-		double ratio = samples[i].ns_per_access / plateau_avg;
-		bool sustained = false;
-		if (ratio > jump_threshold && (int)(i - last_boundary_idx) >= min_plateau_points) {
-			// confirm with a lookahead when possible
-			if (i + 1 < n) {
+// Offset of the next pointer inside a node so that it straddles the requested boundary
+static size_t split_offset(SplitKind split, size_t line_size) {
+	size_t half = sizeof(void *) / 2;
+	switch (split) {
+		case SPLIT_LINE: return line_size - half;
+		case SPLIT_PAGE: return page_size() - half;
+		case SPLIT_NONE:
+		default: return 0;
+	}
+}
+
+// Bytes spanned by nodes whose next pointers sit at off: a split pointer of the last node
+// runs past its node, so this is more than nodes * node_stride for page splits
+static size_t split_footprint(size_t nodes, size_t node_stride, size_t off) {
+	size_t end = (nodes - 1) * node_stride + off + sizeof(void *);
+	return end > nodes * node_stride ? end : nodes * node_stride;
+}
+
+// Largest node count up to nodes whose pointers at off stay within bytes
+static size_t split_fit_nodes(size_t nodes, size_t node_stride, size_t off, size_t bytes) {
+	if (nodes == 0 || bytes < off + sizeof(void *)) return 0;
+	size_t fit = (bytes - off - sizeof(void *)) / node_stride + 1;
+	return nodes < fit ? nodes : fit;
+}
+
+// Buffer and scratch state shared by all modes
+typedef struct Workspace {
+	uint8_t *base;
+	size_t bytes;     // usable buffer size
+	size_t *perm;     // order scratch for up to max_nodes nodes
+	size_t max_nodes;
+	Random64 rng;
+} Workspace;
+
+// Measure a cycle linked at base (ws->base or a separate mapping). Cycles larger than the
+// permutation scratch are linked in streaming form (see build_cycle_streaming). With reorder
+// false the order left in ws->perm by the previous build is re-linked as is, which skips the
+// shuffle when only the placement changes. avail bounds the bytes usable from base; the node
+// count is trimmed so a split pointer never runs past it.
+static double measure_cycle_at(Workspace *ws, uint8_t *base, size_t avail, size_t working_set_bytes, size_t node_stride, bool reorder, const Options *opt, NoiseCounts *noise) {
+	size_t off = split_offset(opt->split, opt->line_size);
+	size_t nodes = split_fit_nodes(nodes_for_size(working_set_bytes, node_stride), node_stride, off, avail);
+	if (nodes < 2) return 0.0; // finalize_options keeps min_bytes above this
+	if (nodes <= ws->max_nodes) {
+		if (reorder) build_order_pattern(ws->perm, nodes, &ws->rng, opt->pattern, opt->pattern_arg);
+		build_cycle_from_order(base, nodes, node_stride, ws->perm, off);
+	} else {
+		static bool warned;
+		if (!warned && opt->pattern != PATTERN_RANDOM && opt->pattern != PATTERN_SEQUENTIAL && opt->pattern != PATTERN_REVERSE) {
+			fprintf(stderr, "Pattern %s has no streaming form; cycles above %zu nodes use random order\n", pattern_name(opt->pattern), ws->max_nodes);
+			warned = true;
+		}
+		build_cycle_streaming(base, nodes, node_stride, &ws->rng, opt->pattern, off);
+	}
+	return time_chase(off ? chase_unaligned : chase, (void *)(base + off), nodes, opt, noise);
+}
+
+// Measure ns per pointer-chase access for a given working set size
+static double measure_ns_per_access(Workspace *ws, size_t working_set_bytes, size_t node_stride, const Options *opt, NoiseCounts *noise) {
+	return measure_cycle_at(ws, ws->base, ws->bytes, working_set_bytes, node_stride, true, opt, noise);
+}
+
+// Spread of one size over --layouts placements
+typedef struct LayoutStats {
+	double mean_ns;
+	double stddev_ns;
+	double min_ns;
+	double max_ns;
+	unsigned layouts;
+} LayoutStats;
+
+// Measure one size over opt->layouts layouts and return the mean. Layout 0 is the usual build
+// at the buffer start. Further layouts move the cycle to a random page-aligned offset in the
+// buffer's slack: fast re-links the same order there, full also reshuffles with the running
+// seed, mmap reshuffles into a freshly mapped and prefaulted region (new physical pages even
+// for the largest size). Sizes whose slack offers fewer page offsets than layouts (the
+// largest ones) fall back to mmap rather than re-timing the same placement.
+static double measure_layouts(Workspace *ws, size_t working_set_bytes, const Options *opt, NoiseCounts *noise, LayoutStats *st) {
+	unsigned k_max = opt->layouts ? opt->layouts : 1;
+	size_t page = page_size();
+	size_t off0 = split_offset(opt->split, opt->line_size);
+	size_t span = split_footprint(nodes_for_size(working_set_bytes, opt->node_stride), opt->node_stride, off0);
+	size_t slack = ws->bytes > span ? ws->bytes - span : 0;
+	LayoutMode mode = opt->layout_mode;
+	if (mode != LAYOUT_MMAP && k_max > 1 && slack / page + 1 < k_max) {
+		static bool warned;
+		if (!warned) {
+			fprintf(stderr, "--layout-mode %s: too little buffer slack from %zu bytes up; using mmap layouts there\n", layout_mode_name(mode), working_set_bytes);
+			warned = true;
+		}
+		mode = LAYOUT_MMAP;
+	}
+	double sum = 0.0, sum_sq = 0.0;
+	st->min_ns = 1e300;
+	st->max_ns = 0.0;
+	st->layouts = 0;
+	for (unsigned k = 0; k < k_max; ++k) {
+		double ns;
+		if (k == 0 || mode != LAYOUT_MMAP) {
+			size_t off = k == 0 ? 0 : rng_uniform(&ws->rng, slack / page + 1) * page;
+			ns = measure_cycle_at(ws, ws->base + off, ws->bytes - off, working_set_bytes, opt->node_stride, k == 0 || mode == LAYOUT_FULL, opt, noise);
+		} else {
+			size_t len = span + page;
+			void *m = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (m == MAP_FAILED) break;
+			uint64_t t0 = now_ns();
+			memset(m, 0, len);
+			phase_add(PHASE_MEMSET, t0);
+			ns = measure_cycle_at(ws, (uint8_t *)m, len, working_set_bytes, opt->node_stride, true, opt, noise);
+			munmap(m, len);
+		}
+		sum += ns;
+		sum_sq += ns * ns;
+		if (ns < st->min_ns) st->min_ns = ns;
+		if (ns > st->max_ns) st->max_ns = ns;
+		st->layouts++;
+	}
+	double n = (double)st->layouts;
+	st->mean_ns = sum / n;
+	double var = sum_sq / n - st->mean_ns * st->mean_ns;
+	st->stddev_ns = var > 0.0 ? sqrt(var) : 0.0;
+	return st->mean_ns;
+}
+
+// Heuristic: detect boundaries where latency jumps vs previous plateau
+typedef struct Boundary {
+	size_t approx_size_bytes;
+	double ratio;
+} Boundary;
+
+static size_t detect_boundaries(const Sample *samples, size_t n, Boundary *out, size_t out_cap) {
+	if (n == 0) return 0;
+	double plateau_sum = samples[0].ns_per_access;
+	int plateau_count = 1;
+	double plateau_avg = plateau_sum / plateau_count;
+	const double jump_threshold = 1.25; // 25% jump
+	const int min_plateau_points = 2;
+	size_t last_boundary_idx = 0;
+	size_t found = 0;
+	for (size_t i = 1; i < n; ++i) {
+		double ratio = samples[i].ns_per_access / plateau_avg;
+		bool sustained = false;
+		if (ratio > jump_threshold && (int)(i - last_boundary_idx) >= min_plateau_points) {
+			// confirm with a lookahead when possible
+			if (i + 1 < n) {
 				double ratio_next = samples[i + 1].ns_per_access / plateau_avg;
 				sustained = ratio_next > (jump_threshold * 0.95);
 			} else {
@@ -491,101 +1706,4518 @@ static const char *human_size(size_t bytes, char *buf, size_t buf_sz) {
 	return buf;
 }
 
-int main(int argc, char **argv) {
-	Options opt;
-	parse_args(argc, argv, &opt);
-	// Generate sizes first
-	const size_t max_samples = 1024;
-	size_t sizes[max_samples];
-	size_t num_sizes = generate_sizes(opt.min_bytes, opt.max_bytes, sizes, max_samples);
-	if (num_sizes == 0) {
-		fprintf(stderr, "No sizes to test.\n");
+static void print_levels(const Options *opt, const Sample *samples, size_t num_samples) {
+	Boundary bounds[8];
+	size_t nb = detect_boundaries(samples, num_samples, bounds, 8);
+	char buf[32];
+	if (opt->json) {
+		for (size_t i = 0; i < nb && i < 8; ++i) {
+			printf("{\"type\":\"level\",\"level\":%zu,\"size_bytes\":%zu,\"ratio\":%.3f}\n", i + 1, bounds[i].approx_size_bytes, bounds[i].ratio);
+		}
+		return;
+	}
+	printf("\nDetected cache levels (approx):\n");
+	for (size_t i = 0; i < nb; ++i) {
+		const char *lvl = (i == 0 ? "L1" : (i == 1 ? "L2" : (i == 2 ? "L3" : (i == 3 ? "L4" : "L?"))));
+		printf("- %s capacity ~ %s (jump x%.2f)\n", lvl, human_size(bounds[i].approx_size_bytes, buf, sizeof(buf)), bounds[i].ratio);
+	}
+	if (nb == 0) {
+		printf("- No clear cache boundaries detected; try increasing --max-bytes or adjusting --node-stride.\n");
+	}
+}
+
+// Mean energy per access of the samples on each plateau, grouped like levels_from_samples;
+// the last group is memory. DRAM energy per memory access against package energy per L3 hit
+// is the comparison power-capped sizing needs.
+static void print_level_energy(const Options *opt, const Sample *samples, size_t n) {
+	Boundary bounds[8];
+	size_t nb = detect_boundaries(samples, n, bounds, 8);
+	if (nb > 8) nb = 8;
+	if (!opt->json) printf("\nEnergy per access (nJ, RAPL; package includes static power of all cores):\n");
+	size_t j = 0;
+	for (size_t l = 0; l <= nb; ++l) {
+		size_t limit = l < nb ? bounds[l].approx_size_bytes : SIZE_MAX;
+		double sum[ENERGY_DOMAINS] = {0.0};
+		size_t cnt = 0;
+		for (; j < n && samples[j].working_set_bytes <= limit; ++j, ++cnt) {
+			for (int d = 0; d < ENERGY_DOMAINS; ++d) sum[d] += samples[j].energy_nj[d];
+		}
+		if (cnt == 0) continue;
+		if (opt->json) {
+			printf("{\"type\":\"level_energy\",\"level\":%zu,\"memory\":%s", l + 1, l == nb ? "true" : "false");
+		} else {
+			char name[8];
+			if (l < nb) snprintf(name, sizeof(name), "L%zu", l + 1);
+			else snprintf(name, sizeof(name), "memory");
+			printf("- %s:", name);
+		}
+		for (int d = 0; d < ENERGY_DOMAINS; ++d) {
+			if (!g_rapl_has[d]) continue;
+			double v = sum[d] / (double)cnt;
+			if (opt->json) printf(",\"%s_nj_per_access\":%.4f", energy_domain_name((EnergyDomain)d), v);
+			else printf(" %s %.3f", energy_domain_name((EnergyDomain)d), v);
+		}
+		printf(opt->json ? "}\n" : "\n");
+	}
+}
+
+// Cache hierarchy as measured by a latency sweep (or given with --cache-sizes)
+typedef struct CacheLevels {
+	size_t count;          // number of cache levels found
+	size_t size_bytes[8];  // approximate capacity per level
+	double latency_ns[9];  // plateau latency per level; [count] is memory (0 when unknown)
+	bool mem_unverified;   // no known LLC size to confirm the last plateau is memory
+} CacheLevels;
+
+// Capacity from boundaries, latency as the mean of the samples belonging to each level
+static void levels_from_samples(const Sample *samples, size_t n, CacheLevels *lv) {
+	Boundary bounds[8];
+	size_t nb = detect_boundaries(samples, n, bounds, 8);
+	if (nb > 8) nb = 8;
+	memset(lv, 0, sizeof(*lv));
+	lv->count = nb;
+	size_t j = 0;
+	for (size_t l = 0; l <= nb; ++l) {
+		size_t limit = l < nb ? bounds[l].approx_size_bytes : SIZE_MAX;
+		if (l < nb) lv->size_bytes[l] = limit;
+		double sum = 0.0;
+		size_t cnt = 0;
+		for (; j < n && samples[j].working_set_bytes <= limit; ++j, ++cnt) sum += samples[j].ns_per_access;
+		lv->latency_ns[l] = cnt ? sum / (double)cnt : 0.0;
+	}
+}
+
+// Run a silent latency sweep and derive the cache levels, unless --cache-sizes was given
+static int measure_levels(const Options *opt, Workspace *ws, const size_t *sizes, size_t num_sizes, CacheLevels *lv) {
+	memset(lv, 0, sizeof(*lv));
+	if (opt->num_cache_sizes > 0) {
+		lv->count = opt->num_cache_sizes;
+		for (size_t i = 0; i < lv->count; ++i) lv->size_bytes[i] = opt->cache_sizes[i];
+		return 0;
+	}
+	Sample *samples = (Sample *)calloc(num_sizes, sizeof(Sample));
+	if (!samples) {
+		fprintf(stderr, "Sample allocation failed\n");
 		return 1;
 	}
+	Options sweep = *opt;
+	sweep.pattern = PATTERN_RANDOM;
+	sweep.split = SPLIT_NONE;
+	for (size_t i = 0; i < num_sizes; ++i) {
+		samples[i].working_set_bytes = sizes[i];
+		samples[i].ns_per_access = measure_ns_per_access(ws, sizes[i], opt->node_stride, &sweep, NULL);
+	}
+	levels_from_samples(samples, num_sizes, lv);
+	free(samples);
+	return 0;
+}
 
-	// Try to allocate a buffer large enough for the largest requested size.
-	// If allocation fails, progressively reduce to the next smaller size.
-	void *raw = NULL;
-	size_t alloc_idx = num_sizes - 1;
-	size_t alloc_bytes = sizes[alloc_idx];
-	int err = posix_memalign(&raw, opt.node_stride, alloc_bytes);
-	while ((err != 0 || raw == NULL) && alloc_idx > 0) {
-		fprintf(stderr, "Allocation of %zu bytes failed (%s). Retrying with smaller size...\n", alloc_bytes, err ? strerror(err) : "unknown");
-		alloc_idx--;
-		alloc_bytes = sizes[alloc_idx];
-		raw = NULL;
-		err = posix_memalign(&raw, opt.node_stride, alloc_bytes);
-	}
-	if (err != 0 || raw == NULL) {
-		fprintf(stderr, "Allocation failed even for smallest size (%zu bytes): %s\n", alloc_bytes, err ? strerror(err) : "unknown");
+// Prefetch distance heuristic: lines in flight needed to cover a memory access when each
+// iteration of a streaming loop costs about one L2 hit
+static size_t prefetch_distance_lines(const CacheLevels *lv) {
+	double mem = lv->latency_ns[lv->count];
+	double step = lv->count > 1 ? lv->latency_ns[1] : (lv->count > 0 ? lv->latency_ns[0] : 0.0);
+	if (mem <= 0.0 || step <= 0.0) return 8;
+	size_t d = (size_t)(mem / step + 0.999);
+	if (d < 2) d = 2;
+	if (d > 64) d = 64;
+	return d;
+}
+
+// Write the measured hierarchy as a C header for cache-specialized builds
+static int write_cache_header(const char *path, const CacheLevels *lv, size_t line_size) {
+	FILE *f = fopen(path, "w");
+	if (!f) {
+		fprintf(stderr, "Cannot write %s: %s\n", path, strerror(errno));
 		return 1;
 	}
-	// Trim test sizes to those that fit in the allocated buffer
-	while (num_sizes > 0 && sizes[num_sizes - 1] > alloc_bytes) {
-		num_sizes--;
+	size_t pd = prefetch_distance_lines(lv);
+	fprintf(f, "/* Generated by cache_detect. Sizes and latencies are measured; the line size\n");
+	fprintf(f, " * is reported by the OS; the prefetch distance is a heuristic (memory / L2 latency). */\n");
+	fprintf(f, "#ifndef CACHE_PARAMS_H\n#define CACHE_PARAMS_H\n\n");
+	fprintf(f, "#define CACHE_LINE_SIZE %zu\n", line_size);
+	fprintf(f, "#define CACHE_LEVELS %zu\n", lv->count);
+	for (size_t l = 0; l < 4; ++l) {
+		fprintf(f, "#define CACHE_L%zu_SIZE %zu\n", l + 1, l < lv->count ? lv->size_bytes[l] : (size_t)0);
+	}
+	fprintf(f, "#define CACHE_PREFETCH_DISTANCE_LINES %zu\n", pd);
+	fprintf(f, "#define CACHE_PREFETCH_DISTANCE_BYTES (CACHE_PREFETCH_DISTANCE_LINES * CACHE_LINE_SIZE)\n\n");
+	for (size_t l = 0; l < 4; ++l) {
+		fprintf(f, "static const double cache_l%zu_latency_ns = %.3f;\n", l + 1, l < lv->count ? lv->latency_ns[l] : 0.0);
 	}
-	uint8_t *base = (uint8_t *)raw;
-	memset(base, 0, alloc_bytes);
+	double mem = lv->latency_ns[lv->count];
+	if (mem > 0.0) {
+		fprintf(f, "static const double cache_mem_latency_ns = %.3f;%s\n", mem, lv->mem_unverified ? " /* unverified: LLC size unknown */" : "");
+	} else {
+		fprintf(f, "/* cache_mem_latency_ns omitted: the sweep did not reach beyond the last-level cache */\n");
+	}
+	fprintf(f, "\n#endif /* CACHE_PARAMS_H */\n");
+	fclose(f);
+	return 0;
+}
 
-	// Prepare permutation array for up to max nodes within allocated buffer
-	size_t max_nodes = alloc_bytes / opt.node_stride;
-	size_t *perm = (size_t *)malloc(max_nodes * sizeof(size_t));
-	if (!perm) {
-		fprintf(stderr, "Permutation allocation failed\n");
-		free(raw);
+// Same values as write_cache_header in key=value form for runtime configuration
+static int write_cache_config(const char *path, const CacheLevels *lv, size_t line_size) {
+	FILE *f = fopen(path, "w");
+	if (!f) {
+		fprintf(stderr, "Cannot write %s: %s\n", path, strerror(errno));
 		return 1;
 	}
+	fprintf(f, "line_size=%zu\n", line_size);
+	fprintf(f, "levels=%zu\n", lv->count);
+	for (size_t l = 0; l < lv->count; ++l) {
+		fprintf(f, "l%zu_size=%zu\n", l + 1, lv->size_bytes[l]);
+		fprintf(f, "l%zu_latency_ns=%.3f\n", l + 1, lv->latency_ns[l]);
+	}
+	if (lv->latency_ns[lv->count] > 0.0) {
+		fprintf(f, "mem_latency_ns=%.3f\n", lv->latency_ns[lv->count]);
+		if (lv->mem_unverified) fprintf(f, "mem_latency_verified=0\n");
+	}
+	fprintf(f, "prefetch_distance_lines=%zu\n", prefetch_distance_lines(lv));
+	fclose(f);
+	return 0;
+}
+
+// Phase breakdown on stderr and, with --json, as a record. ns holds per-phase nanoseconds;
+// size_bytes 0 marks the run total, where wall_ns adds the time outside all phases.
+static void report_phases(const Options *opt, const uint64_t *ns, size_t size_bytes, uint64_t wall_ns) {
+	uint64_t sum = 0;
+	for (int p = 0; p < PHASE_COUNT; ++p) sum += ns[p];
+	double other_ms = wall_ns > sum ? (double)(wall_ns - sum) / 1e6 : 0.0;
+	if (size_bytes) fprintf(stderr, "phases %zu:", size_bytes);
+	else fprintf(stderr, "phases total:");
+	bool first = true;
+	for (int p = 0; p < PHASE_COUNT; ++p) {
+		if (size_bytes && (p == PHASE_ALLOC || p == PHASE_MEMSET) && ns[p] == 0) continue;
+		fprintf(stderr, "%s %s %.1f ms", first ? "" : ",", phase_name((Phase)p), (double)ns[p] / 1e6);
+		first = false;
+	}
+	if (!size_bytes) fprintf(stderr, ", other %.1f ms (wall %.1f ms)", other_ms, (double)wall_ns / 1e6);
+	fprintf(stderr, "\n");
+	if (opt->json) {
+		if (size_bytes) printf("{\"type\":\"phases\",\"size_bytes\":%zu", size_bytes);
+		else printf("{\"type\":\"phases_total\"");
+		for (int p = 0; p < PHASE_COUNT; ++p) printf(",\"%s_ms\":%.3f", phase_name((Phase)p), (double)ns[p] / 1e6);
+		if (!size_bytes) printf(",\"other_ms\":%.3f,\"wall_ms\":%.3f", other_ms, (double)wall_ns / 1e6);
+		printf("}\n");
+	}
+}
+
+// Per-size details of a latency sample that only the report needs
+typedef struct SampleExtra {
+	LayoutStats st;
+	uint64_t phase_ns[PHASE_COUNT];
+} SampleExtra;
+
+// Measure one latency sample (with --layouts, the ensemble) and the phases it took
+static void measure_latency_sample(Workspace *ws, size_t wsb, const Options *opt, Sample *out, SampleExtra *x) {
+	NoiseCounts noise = {0};
+	uint64_t phase0[PHASE_COUNT];
+	memcpy(phase0, g_phase_ns, sizeof(phase0));
+	EnergyTotals energy0 = g_energy;
+	memset(&x->st, 0, sizeof(x->st));
+	double ns = opt->layouts > 1 ? measure_layouts(ws, wsb, opt, &noise, &x->st) : measure_ns_per_access(ws, wsb, opt->node_stride, opt, &noise);
+	for (int p = 0; p < PHASE_COUNT; ++p) x->phase_ns[p] = g_phase_ns[p] - phase0[p];
+	out->working_set_bytes = wsb;
+	out->ns_per_access = ns;
+	out->noise = noise;
+	energy_since(&energy0, out->energy_nj);
+}
+
+static void print_latency_sample(const Options *opt, const Sample *smp, const SampleExtra *x) {
+	bool ensemble = opt->layouts > 1;
+	bool energy = energy_on(opt);
+	const LayoutStats *st = &x->st;
+	const NoiseCounts *noise = &smp->noise;
+	size_t wsb = smp->working_set_bytes;
+	if (opt->json) {
+		printf("{\"type\":\"sample\",\"size_bytes\":%zu,\"ns_per_access\":%.3f", wsb, smp->ns_per_access);
+		if (ensemble) {
+			printf(",\"layouts\":%u,\"stddev_ns\":%.3f,\"min_ns\":%.3f,\"max_ns\":%.3f", st->layouts, st->stddev_ns, st->min_ns, st->max_ns);
+		}
+		if (opt->reject_noisy) {
+			printf(",\"rejected\":%u,\"ctx_switches\":%" PRIu64 ",\"page_faults\":%" PRIu64 ",\"interrupts\":%" PRIu64 ",\"steal_ticks\":%" PRIu64,
+				noise->rejected, noise->ctx_switches, noise->page_faults, noise->interrupts, noise->steal_ticks);
+		}
+		for (int d = 0; energy && d < ENERGY_DOMAINS; ++d) {
+			if (g_rapl_has[d]) printf(",\"%s_nj_per_access\":%.4f", energy_domain_name((EnergyDomain)d), smp->energy_nj[d]);
+		}
+		printf("}\n");
+		fflush(stdout);
+	} else if (opt->print_table) {
+		printf("%zu\t%.3f", wsb, smp->ns_per_access);
+		if (ensemble) printf("\t%.3f\t%.3f\t%.3f", st->stddev_ns, st->min_ns, st->max_ns);
+		if (opt->reject_noisy) {
+			printf("\t%u\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64,
+				noise->rejected, noise->ctx_switches, noise->page_faults, noise->interrupts, noise->steal_ticks);
+		}
+		for (int d = 0; energy && d < ENERGY_DOMAINS; ++d) {
+			if (g_rapl_has[d]) printf("\t%.4f", smp->energy_nj[d]);
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+	report_phases(opt, x->phase_ns, wsb, 0);
+}
+
+// Share of each CPU's time spent idle over ms milliseconds, from /proc/stat (1.0 when unknown)
+static void cpu_idle_shares(const int *cpus, size_t n, double *idle, unsigned ms) {
+	uint64_t busy0[MAX_CPUS] = {0}, idle0[MAX_CPUS] = {0};
+	for (size_t i = 0; i < n; ++i) idle[i] = 1.0;
+#if defined(__linux__)
+	for (int pass = 0; pass < 2; ++pass) {
+		if (pass) sleep_ms(ms);
+		FILE *f = fopen("/proc/stat", "r");
+		if (!f) return;
+		char line[512];
+		while (fgets(line, sizeof(line), f)) {
+			int cpu;
+			unsigned long long v[8] = {0};
+			if (sscanf(line, "cpu%d %llu %llu %llu %llu %llu %llu %llu %llu", &cpu, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]) < 5) continue;
+			for (size_t i = 0; i < n; ++i) {
+				if (cpus[i] != cpu || cpu < 0 || cpu >= MAX_CPUS) continue;
+				uint64_t id = v[3] + v[4];
+				uint64_t bz = v[0] + v[1] + v[2] + v[5] + v[6] + v[7];
+				if (pass == 0) {
+					idle0[i] = id;
+					busy0[i] = bz;
+				} else {
+					uint64_t di = id - idle0[i], db = bz - busy0[i];
+					idle[i] = di + db ? (double)di / (double)(di + db) : 1.0;
+				}
+			}
+		}
+		fclose(f);
+	}
+#else
+	(void)cpus;
+	(void)ms;
+#endif
+}
+
+typedef struct SweepWorker {
+	int cpu;
+	const Options *opt;
+	const size_t *sizes;
+	size_t count;          // sizes[0..count) are shared out
+	size_t buf_bytes;
+	atomic_size_t *next;
+	Sample *samples;
+	SampleExtra *extra;
+	uint64_t seed;
+	uint64_t phase_ns[PHASE_COUNT]; // the worker's phase totals, handed back to the caller
+	bool ok;
+} SweepWorker;
+
+// Take sizes off the shared counter and measure them with a private buffer on this CPU
+static void *sweep_worker(void *arg) {
+	SweepWorker *w = (SweepWorker *)arg;
+	if (!pin_to_cpu(w->cpu)) {
+		// unpinned samples could share a core with another worker: fail the parallel part
+		w->ok = false;
+		return NULL;
+	}
+	Options o = *w->opt;
+	o.cpu = w->cpu;
+	Workspace ws;
+	memset(&ws, 0, sizeof(ws));
+	uint64_t t0 = now_ns();
+	void *raw = NULL;
+	if (posix_memalign(&raw, page_size(), w->buf_bytes) == 0) {
+		ws.base = (uint8_t *)raw;
+		ws.bytes = w->buf_bytes;
+		ws.max_nodes = w->buf_bytes / o.node_stride;
+		ws.perm = (size_t *)malloc(ws.max_nodes * sizeof(size_t));
+	}
+	phase_add(PHASE_ALLOC, t0);
+	w->ok = ws.base && ws.perm;
+	if (w->ok) {
+		t0 = now_ns();
+		memset(ws.base, 0, ws.bytes); // first touch from this CPU: local memory
+		phase_add(PHASE_MEMSET, t0);
+		ws.rng.state = w->seed;
+		for (;;) {
+			size_t i = atomic_fetch_add(w->next, 1);
+			if (i >= w->count) break;
+			measure_latency_sample(&ws, w->sizes[i], &o, &w->samples[i], &w->extra[i]);
+		}
+	}
+	free(ws.perm);
+	free(raw);
+	memcpy(w->phase_ns, g_phase_ns, sizeof(w->phase_ns));
+	return NULL;
+}
+
+// Measure the leading sizes that fit the per-core L2 on up to opt->parallel idle CPUs with
+// distinct L2s (one thread and buffer each). Returns how many leading sizes were measured;
+// 0 leaves the whole sweep to the serial loop.
+static size_t sweep_private_parallel(const Options *opt, const size_t *sizes, size_t num_sizes, Sample *samples, SampleExtra *extra) {
+	if (energy_on(opt)) {
+		fprintf(stderr, "--parallel ignored with --energy (package counters are shared by all cores)\n");
+		return 0;
+	}
+	int home = opt->cpu >= 0 ? opt->cpu : current_cpu();
+	size_t cs[4];
+	size_t home_levels = read_sysfs_cache_sizes(home, cs, 4);
+	size_t l2 = opt->num_cache_sizes >= 2 ? opt->cache_sizes[1] : (home_levels >= 2 ? cs[1] : 0);
+	size_t count = 0;
+	while (count < num_sizes && l2 != 0 && sizes[count] <= l2) count++;
+	if (count < 2) {
+		fprintf(stderr, "--parallel: private L2 size unknown or no sizes below it; sweeping serially\n");
+		return 0;
+	}
+	CpuInfo *topo = (CpuInfo *)calloc(MAX_CPUS, sizeof(CpuInfo));
+	int *cand = (int *)calloc(MAX_CPUS, sizeof(int));
+	double *idle = (double *)calloc(MAX_CPUS, sizeof(double));
+	SweepWorker *w = (SweepWorker *)calloc(opt->parallel, sizeof(SweepWorker));
+	pthread_t *th = (pthread_t *)calloc(opt->parallel, sizeof(pthread_t));
+	size_t nw = 0;
+	if (topo && cand && idle && w && th) {
+		// one CPU per L2 domain, the home CPU's first, then the idle ones (>= 90% idle). Only
+		// CPUs in our affinity mask (read_topology) whose cache sizes match the home CPU's, so
+		// the sizes cut at the home L2 fit every worker's L2 (hybrid parts mix core types).
+		size_t nt = read_topology(topo, MAX_CPUS);
+		size_t nc = 0;
+		for (int pass = 0; pass < 2; ++pass) {
+			for (size_t i = 0; i < nt; ++i) {
+				if ((pass == 0) != (topo[i].cpu == home)) continue;
+				size_t other[4];
+				if (read_sysfs_cache_sizes(topo[i].cpu, other, 4) != home_levels || memcmp(other, cs, sizeof(cs)) != 0) continue;
+				bool taken = false;
+				for (size_t k = 0; k < nc; ++k) {
+					for (size_t t = 0; t < nt; ++t) {
+						if (topo[t].cpu != cand[k]) continue;
+						bool same_l2 = topo[t].l2 >= 0 ? topo[t].l2 == topo[i].l2 : (topo[t].core == topo[i].core && topo[t].package == topo[i].package);
+						taken = taken || same_l2;
+					}
+				}
+				if (!taken) cand[nc++] = topo[i].cpu;
+			}
+		}
+		cpu_idle_shares(cand, nc, idle, 100);
+		for (size_t i = 0; i < nc && nw < opt->parallel; ++i) {
+			if (idle[i] < 0.9) continue;
+			w[nw].cpu = cand[i];
+			nw++;
+		}
+	}
+	size_t done = 0;
+	if (nw >= 2) {
+		atomic_size_t next;
+		atomic_init(&next, 0);
+		size_t started = 0;
+		for (size_t k = 0; k < nw; ++k) {
+			w[k].opt = opt;
+			w[k].sizes = sizes;
+			w[k].count = count;
+			w[k].buf_bytes = sizes[count - 1] * 2; // slack for --layouts
+			w[k].next = &next;
+			w[k].samples = samples;
+			w[k].extra = extra;
+			w[k].seed = (uint64_t)now_ns() ^ ((uint64_t)(k + 1) * 0x9e3779b97f4a7c15ULL);
+			if (pthread_create(&th[k], NULL, sweep_worker, &w[k]) != 0) break;
+			started++;
+		}
+		bool ok = started > 0;
+		for (size_t k = 0; k < started; ++k) {
+			pthread_join(th[k], NULL);
+			ok = ok && w[k].ok;
+			for (int p = 0; p < PHASE_COUNT; ++p) g_phase_ns[p] += w[k].phase_ns[p];
+		}
+		if (ok) {
+			done = count;
+			fprintf(stderr, "--parallel: %zu sizes up to %zu bytes measured on CPUs", count, sizes[count - 1]);
+			for (size_t k = 0; k < started; ++k) fprintf(stderr, "%s%d", k ? "," : " ", w[k].cpu);
+			fprintf(stderr, "\n");
+		} else {
+			fprintf(stderr, "--parallel: worker setup or pinning failed; sweeping serially\n");
+		}
+	} else {
+		fprintf(stderr, "--parallel: fewer than two allowed idle CPUs with their own, matching L2; sweeping serially\n");
+	}
+	free(th);
+	free(w);
+	free(idle);
+	free(cand);
+	free(topo);
+	return done;
+}
 
+static int run_latency_mode(const Options *opt, Workspace *ws, const size_t *sizes, size_t num_sizes) {
 	Sample *samples = (Sample *)calloc(num_sizes, sizeof(Sample));
-	if (!samples) {
+	SampleExtra *slots = (SampleExtra *)calloc(num_sizes, sizeof(SampleExtra));
+	if (!samples || !slots) {
 		fprintf(stderr, "Sample allocation failed\n");
-		free(perm);
-		free(raw);
+		free(samples);
+		free(slots);
 		return 1;
 	}
+	bool ensemble = opt->layouts > 1;
+	bool energy = energy_on(opt);
+	if (opt->json) {
+		printf("{\"type\":\"config\",\"mode\":\"%s\",\"node_stride\":%zu,\"pattern\":\"%s\",\"pattern_arg\":%zu,\"cpu\":%d,\"reject_noisy\":%s,\"layouts\":%u,\"layout_mode\":\"%s\"}\n",
+			mode_name(opt->mode), opt->node_stride, pattern_name(opt->pattern), opt->pattern_arg, opt->cpu, opt->reject_noisy ? "true" : "false",
+			opt->layouts, layout_mode_name(opt->layout_mode));
+	} else if (opt->print_table) {
+		printf("# Cache size detection via pointer-chasing (node_stride=%zub, pattern=%s", opt->node_stride, pattern_name(opt->pattern));
+		if (opt->pattern == PATTERN_STRIDE) {
+			printf(", step=%zu", opt->pattern_arg == 0 ? (size_t)1 : opt->pattern_arg);
+		}
+		if (opt->split != SPLIT_NONE) {
+			printf(", split=%s", opt->split == SPLIT_LINE ? "line" : "page");
+		}
+		if (ensemble) {
+			printf(", layouts=%u %s", opt->layouts, layout_mode_name(opt->layout_mode));
+		}
+		printf(")\n");
+		printf("# size_bytes\tlatency_ns_per_access%s%s", ensemble ? "\tstddev_ns\tmin_ns\tmax_ns" : "",
+			opt->reject_noisy ? "\trejected\tctx_switches\tpage_faults\tinterrupts\tsteal_ticks" : "");
+		for (int d = 0; energy && d < ENERGY_DOMAINS; ++d) {
+			if (g_rapl_has[d]) printf("\t%s_nj_per_access", energy_domain_name((EnergyDomain)d));
+		}
+		printf("\n");
+	}
 
-	Random64 rng;
-	// seed from address entropy and time
-	uint64_t seed = (uint64_t)now_ns() ^ (uint64_t)(uintptr_t)&rng ^ (uint64_t)getpid();
-	if (seed == 0) seed = 0x123456789abcdefULL;
-	rng.state = seed;
+	// sizes that fit the private levels may be measured on several idle cores first
+	size_t parallel_done = 0;
+	if (opt->parallel > 1) parallel_done = sweep_private_parallel(opt, sizes, num_sizes, samples, slots);
+	for (size_t i = 0; i < num_sizes; ++i) {
+		if (i >= parallel_done) measure_latency_sample(ws, sizes[i], opt, &samples[i], &slots[i]);
+		print_latency_sample(opt, &samples[i], &slots[i]);
+	}
 
-	if (opt.print_table) {
-		printf("# Cache size detection via pointer-chasing (node_stride=%zub, pattern=%s", opt.node_stride, pattern_name(opt.pattern));
-		if (opt.pattern == PATTERN_STRIDE) {
-			printf(", step=%zu", opt.pattern_arg == 0 ? (size_t)1 : opt.pattern_arg);
+	print_levels(opt, samples, num_sizes);
+	if (energy) print_level_energy(opt, samples, num_sizes);
+	int rc = 0;
+	if (opt->header_path || opt->config_path) {
+		CacheLevels lv;
+		levels_from_samples(samples, num_sizes, &lv);
+		// the last plateau is memory only when it starts at the last-level cache; otherwise
+		// the sweep stopped inside a cache level and there is no memory latency to report
+		size_t known[8];
+		size_t nk = opt->num_cache_sizes > 0 ? opt->num_cache_sizes : read_sysfs_cache_sizes(opt->cpu >= 0 ? opt->cpu : current_cpu(), known, 8);
+		size_t llc = 0;
+		for (size_t l = 0; l < nk && l < 8; ++l) {
+			size_t v = opt->num_cache_sizes > 0 ? opt->cache_sizes[l] : known[l];
+			if (v > llc) llc = v;
 		}
-		printf(")\n");
-		printf("# size_bytes\tlatency_ns_per_access\n");
+		if (llc == 0) {
+			lv.mem_unverified = true;
+		} else if (lv.count == 0 || lv.size_bytes[lv.count - 1] < llc / 2) {
+			lv.latency_ns[lv.count] = 0.0;
+			fprintf(stderr, "Sweep did not go beyond the %zu-byte last-level cache; memory latency omitted (raise --max-bytes)\n", llc);
+		}
+		if (opt->header_path) rc |= write_cache_header(opt->header_path, &lv, opt->line_size);
+		if (opt->config_path) rc |= write_cache_config(opt->config_path, &lv, opt->line_size);
 	}
+	free(slots);
+	free(samples);
+	return rc;
+}
 
+// For each size, time the plain chase and every barrier variant over the same cycle and
+// report the cost each barrier adds per hop.
+static int run_fence_mode(const Options *opt, Workspace *ws, const size_t *sizes, size_t num_sizes) {
+	if (opt->json) {
+		printf("{\"type\":\"config\",\"mode\":\"%s\",\"node_stride\":%zu,\"pattern\":\"%s\",\"cpu\":%d}\n",
+			mode_name(opt->mode), opt->node_stride, pattern_name(opt->pattern), opt->cpu);
+	} else if (opt->print_table) {
+		printf("# Barrier cost per hop via pointer-chasing (node_stride=%zub, pattern=%s)\n", opt->node_stride, pattern_name(opt->pattern));
+		printf("# size_bytes\tbase_ns");
+		for (size_t k = 0; k < NUM_BARRIER_KINDS; ++k) printf("\t%s_added_ns", barrier_kinds[k].name);
+		printf("%s\n", opt->reject_noisy ? "\trejected(base/variants)" : "");
+	}
 	for (size_t i = 0; i < num_sizes; ++i) {
-		size_t ws = sizes[i];
-		double ns = measure_ns_per_access(base, ws, opt.node_stride, perm, &rng, &opt);
-		samples[i].working_set_bytes = ws;
-		samples[i].ns_per_access = ns;
-		if (opt.print_table) {
-			printf("%zu\t%.3f\n", ws, ns);
-			fflush(stdout);
+		size_t wsb = sizes[i];
+		size_t nodes = nodes_for_size(wsb, opt->node_stride);
+		build_cycle_pattern(ws->base, nodes, opt->node_stride, ws->perm, &ws->rng, opt->pattern, opt->pattern_arg, 0);
+		// each timing gets its own retry budget (--noise-retries)
+		NoiseCounts noise[1 + NUM_BARRIER_KINDS];
+		memset(noise, 0, sizeof(noise));
+		double base_ns = time_chase(chase, ws->base, nodes, opt, &noise[0]);
+		if (opt->json) {
+			printf("{\"type\":\"fence\",\"size_bytes\":%zu,\"barrier\":\"none\",\"ns_per_access\":%.3f,\"added_ns\":0", wsb, base_ns);
+			if (opt->reject_noisy) {
+				printf(",\"rejected\":%u,\"ctx_switches\":%" PRIu64 ",\"page_faults\":%" PRIu64 ",\"interrupts\":%" PRIu64 ",\"steal_ticks\":%" PRIu64,
+					noise[0].rejected, noise[0].ctx_switches, noise[0].page_faults, noise[0].interrupts, noise[0].steal_ticks);
+			}
+			printf("}\n");
+		} else if (opt->print_table) {
+			printf("%zu\t%.3f", wsb, base_ns);
+		}
+		for (size_t k = 0; k < NUM_BARRIER_KINDS; ++k) {
+			NoiseCounts *nc = &noise[1 + k];
+			double ns = time_chase(barrier_kinds[k].fn, ws->base, nodes, opt, nc);
+			if (opt->json) {
+				printf("{\"type\":\"fence\",\"size_bytes\":%zu,\"barrier\":\"%s\",\"ns_per_access\":%.3f,\"added_ns\":%.3f",
+					wsb, barrier_kinds[k].name, ns, ns - base_ns);
+				if (opt->reject_noisy) {
+					printf(",\"rejected\":%u,\"ctx_switches\":%" PRIu64 ",\"page_faults\":%" PRIu64 ",\"interrupts\":%" PRIu64 ",\"steal_ticks\":%" PRIu64,
+						nc->rejected, nc->ctx_switches, nc->page_faults, nc->interrupts, nc->steal_ticks);
+				}
+				printf("}\n");
+			} else if (opt->print_table) {
+				printf("\t%.3f", ns - base_ns);
+			}
+		}
+		if (!opt->json && opt->print_table) {
+			if (opt->reject_noisy) {
+				printf("\t");
+				for (size_t k = 0; k <= NUM_BARRIER_KINDS; ++k) printf("%s%u", k ? "/" : "", noise[k].rejected);
+			}
+			printf("\n");
 		}
+		fflush(stdout);
 	}
+	return 0;
+}
 
-	Boundary bounds[8];
-	size_t nb = detect_boundaries(samples, num_sizes, bounds, 8);
-	char buf[32];
-	printf("\nDetected cache levels (approx):\n");
-	for (size_t i = 0; i < nb; ++i) {
-		const char *lvl = (i == 0 ? "L1" : (i == 1 ? "L2" : (i == 2 ? "L3" : (i == 3 ? "L4" : "L?"))));
-		printf("- %s capacity ~ %s (jump x%.2f)\n", lvl, human_size(bounds[i].approx_size_bytes, buf, sizeof(buf)), bounds[i].ratio);
+// For each size, time aligned vs line-split pointers (at node_stride) and aligned vs
+// page-split pointers (at whole-page node stride), plus split-lock atomics when requested,
+// then summarize the penalties per detected cache level.
+static int run_split_mode(const Options *opt, Workspace *ws, const size_t *sizes, size_t num_sizes) {
+	size_t page = page_size();
+	size_t line = opt->line_size;
+	size_t line_stride = opt->node_stride;
+	if (line_stride < line + sizeof(void *)) line_stride = line * 2;
+	size_t page_stride = (opt->node_stride + page - 1) / page * page;
+	uint8_t *page_base = (uint8_t *)(((uintptr_t)ws->base + page - 1) & ~(uintptr_t)(page - 1));
+	size_t page_bytes = ws->bytes - (size_t)(page_base - ws->base);
+	size_t line_off = split_offset(SPLIT_LINE, line);
+	size_t page_off = split_offset(SPLIT_PAGE, line);
+	bool do_lock = false;
+#if defined(HAVE_LOCKED_CHASE)
+	do_lock = opt->split_lock;
+	if (do_lock) {
+		const char *why = split_lock_probe(line);
+		if (why) {
+			fprintf(stderr, "Skipping split-lock timing: %s.\n", why);
+			do_lock = false;
+		}
 	}
-	if (nb == 0) {
-		printf("- No clear cache boundaries detected; try increasing --max-bytes or adjusting --node-stride.\n");
+#else
+	if (opt->split_lock) fprintf(stderr, "--split-lock is only available on x86-64; skipping.\n");
+#endif
+	Sample *aligned = (Sample *)calloc(num_sizes, sizeof(Sample));
+	double *line_pen = (double *)calloc(num_sizes, sizeof(double));
+	double *page_pen = (double *)calloc(num_sizes, sizeof(double));
+	double *lock_pen = (double *)calloc(num_sizes, sizeof(double));
+	if (!aligned || !line_pen || !page_pen || !lock_pen) {
+		fprintf(stderr, "Sample allocation failed\n");
+		free(aligned);
+		free(line_pen);
+		free(page_pen);
+		free(lock_pen);
+		return 1;
+	}
+	if (opt->json) {
+		printf("{\"type\":\"config\",\"mode\":\"%s\",\"line_size\":%zu,\"page_size\":%zu,\"line_stride\":%zu,\"page_stride\":%zu,\"pattern\":\"%s\",\"split_lock\":%s}\n",
+			mode_name(opt->mode), line, page, line_stride, page_stride, pattern_name(opt->pattern), do_lock ? "true" : "false");
+	} else if (opt->print_table) {
+		printf("# Split load penalty via pointer-chasing (line=%zub, page=%zub, pattern=%s)\n", line, page, pattern_name(opt->pattern));
+		printf("# size_bytes\taligned_ns\tline_split_ns\tline_penalty_ns\tpage_aligned_ns\tpage_split_ns\tpage_penalty_ns");
+		if (do_lock) printf("\tlocked_ns\tsplit_locked_ns\tsplit_lock_penalty_ns");
+		printf("\n");
+	}
+	size_t done = 0;
+	for (size_t i = 0; i < num_sizes; ++i) {
+		size_t wsb = sizes[i];
+		size_t nodes = split_fit_nodes(nodes_for_size(wsb, line_stride), line_stride, line_off, ws->bytes);
+		build_order_pattern(ws->perm, nodes, &ws->rng, opt->pattern, opt->pattern_arg);
+		build_cycle_from_order(ws->base, nodes, line_stride, ws->perm, 0);
+		double a_ns = time_chase(chase, ws->base, nodes, opt, NULL);
+		double l_ns = 0.0, la_ns = 0.0, ls_ns = 0.0;
+#if defined(HAVE_LOCKED_CHASE)
+		if (do_lock) la_ns = time_chase(chase_locked, ws->base, nodes, opt, NULL);
+#endif
+		build_cycle_from_order(ws->base, nodes, line_stride, ws->perm, line_off);
+		l_ns = time_chase(chase_unaligned, ws->base + line_off, nodes, opt, NULL);
+#if defined(HAVE_LOCKED_CHASE)
+		if (do_lock) ls_ns = time_chase(chase_locked, ws->base + line_off, nodes, opt, NULL);
+#endif
+		// page variant: one node per page (at least two pages)
+		size_t pnodes = nodes_for_size(wsb, page_stride);
+		pnodes = split_fit_nodes(pnodes, page_stride, page_off, page_bytes);
+		double pa_ns = 0.0, ps_ns = 0.0;
+		if (pnodes >= 2) {
+			build_order_pattern(ws->perm, pnodes, &ws->rng, opt->pattern, opt->pattern_arg);
+			build_cycle_from_order(page_base, pnodes, page_stride, ws->perm, 0);
+			pa_ns = time_chase(chase, page_base, pnodes, opt, NULL);
+			build_cycle_from_order(page_base, pnodes, page_stride, ws->perm, page_off);
+			ps_ns = time_chase(chase_unaligned, page_base + page_off, pnodes, opt, NULL);
+		}
+		aligned[i].working_set_bytes = wsb;
+		aligned[i].ns_per_access = a_ns;
+		line_pen[i] = l_ns - a_ns;
+		page_pen[i] = ps_ns - pa_ns;
+		lock_pen[i] = ls_ns - la_ns;
+		done++;
+		if (opt->json) {
+			printf("{\"type\":\"split\",\"size_bytes\":%zu,\"aligned_ns\":%.3f,\"line_split_ns\":%.3f,\"page_aligned_ns\":%.3f,\"page_split_ns\":%.3f",
+				wsb, a_ns, l_ns, pa_ns, ps_ns);
+			if (do_lock) printf(",\"locked_ns\":%.3f,\"split_locked_ns\":%.3f", la_ns, ls_ns);
+			printf("}\n");
+		} else if (opt->print_table) {
+			printf("%zu\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f", wsb, a_ns, l_ns, line_pen[i], pa_ns, ps_ns, page_pen[i]);
+			if (do_lock) printf("\t%.3f\t%.3f\t%.3f", la_ns, ls_ns, lock_pen[i]);
+			printf("\n");
+		}
+		fflush(stdout);
 	}
 
-	free(samples);
-	free(perm);
-	free(raw);
+	// average penalties over the sizes belonging to each level (boundaries of the aligned curve)
+	Boundary bounds[8];
+	size_t nb = detect_boundaries(aligned, done, bounds, 8);
+	if (nb > 8) nb = 8;
+	if (!opt->json) printf("\nSplit penalty per level (avg added ns per access):\n");
+	size_t start = 0;
+	for (size_t lvl = 0; lvl <= nb && start < done; ++lvl) {
+		size_t limit = lvl < nb ? bounds[lvl].approx_size_bytes : SIZE_MAX;
+		double lsum = 0.0, psum = 0.0, ksum = 0.0;
+		size_t cnt = 0;
+		size_t j = start;
+		for (; j < done && aligned[j].working_set_bytes <= limit; ++j, ++cnt) {
+			lsum += line_pen[j];
+			psum += page_pen[j];
+			ksum += lock_pen[j];
+		}
+		if (cnt == 0) break;
+		char name[8];
+		if (lvl < nb) snprintf(name, sizeof(name), "L%zu", lvl + 1);
+		else snprintf(name, sizeof(name), "memory");
+		if (opt->json) {
+			printf("{\"type\":\"split_level\",\"level\":\"%s\",\"line_penalty_ns\":%.3f,\"page_penalty_ns\":%.3f", name, lsum / (double)cnt, psum / (double)cnt);
+			if (do_lock) printf(",\"split_lock_penalty_ns\":%.3f", ksum / (double)cnt);
+			printf("}\n");
+		} else {
+			printf("- %s: line split +%.2f ns, page split +%.2f ns", name, lsum / (double)cnt, psum / (double)cnt);
+			if (do_lock) printf(", split lock +%.2f ns", ksum / (double)cnt);
+			printf("\n");
+		}
+		start = j;
+	}
+	free(aligned);
+	free(line_pen);
+	free(page_pen);
+	free(lock_pen);
 	return 0;
 }
 
+// ---------------------------------------------------------------------------
+// Bandwidth kernels (copy strategies) timed with source/destination in chosen cache states
+// ---------------------------------------------------------------------------
+
+// Copy n bytes from src to dst
+typedef void (*BwFn)(void *dst, const void *src, size_t n);
+
+typedef struct BwKernel {
+	const char *name;
+	BwFn fn;
+} BwKernel;
+
+static void copy_libc(void *dst, const void *src, size_t n) {
+	memcpy(dst, src, n);
+}
+
+#if defined(HAVE_X86_INTRINSICS)
+static void copy_rep_movsb(void *dst, const void *src, size_t n) {
+	__asm__ __volatile__("rep movsb" : "+D"(dst), "+S"(src), "+c"(n) : : "memory");
+}
+
+TARGET_SSE2 static void copy_sse(void *dst, const void *src, size_t n) {
+	uint8_t *d = (uint8_t *)dst;
+	const uint8_t *s = (const uint8_t *)src;
+	size_t i = 0;
+	for (; i + 64 <= n; i += 64) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(const void *)(s + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(const void *)(s + i + 16));
+		__m128i c = _mm_loadu_si128((const __m128i *)(const void *)(s + i + 32));
+		__m128i e = _mm_loadu_si128((const __m128i *)(const void *)(s + i + 48));
+		_mm_storeu_si128((__m128i *)(void *)(d + i), a);
+		_mm_storeu_si128((__m128i *)(void *)(d + i + 16), b);
+		_mm_storeu_si128((__m128i *)(void *)(d + i + 32), c);
+		_mm_storeu_si128((__m128i *)(void *)(d + i + 48), e);
+	}
+	if (i < n) memcpy(d + i, s + i, n - i);
+}
+
+__attribute__((target("avx"))) static void copy_avx(void *dst, const void *src, size_t n) {
+	uint8_t *d = (uint8_t *)dst;
+	const uint8_t *s = (const uint8_t *)src;
+	size_t i = 0;
+	for (; i + 64 <= n; i += 64) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(const void *)(s + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(const void *)(s + i + 32));
+		_mm256_storeu_si256((__m256i *)(void *)(d + i), a);
+		_mm256_storeu_si256((__m256i *)(void *)(d + i + 32), b);
+	}
+	if (i < n) memcpy(d + i, s + i, n - i);
+	_mm256_zeroupper();
+}
+
+__attribute__((target("avx512f"))) static void copy_avx512(void *dst, const void *src, size_t n) {
+	uint8_t *d = (uint8_t *)dst;
+	const uint8_t *s = (const uint8_t *)src;
+	size_t i = 0;
+	for (; i + 128 <= n; i += 128) {
+		__m512i a = _mm512_loadu_si512((const void *)(s + i));
+		__m512i b = _mm512_loadu_si512((const void *)(s + i + 64));
+		_mm512_storeu_si512((void *)(d + i), a);
+		_mm512_storeu_si512((void *)(d + i + 64), b);
+	}
+	if (i < n) memcpy(d + i, s + i, n - i);
+}
+
+// Non-temporal (streaming) stores: destination bypasses the cache hierarchy
+TARGET_SSE2 static void copy_nt(void *dst, const void *src, size_t n) {
+	uint8_t *d = (uint8_t *)dst;
+	const uint8_t *s = (const uint8_t *)src;
+	size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+	if (head > n) head = n;
+	memcpy(d, s, head);
+	size_t i = head;
+	for (; i + 64 <= n; i += 64) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(const void *)(s + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(const void *)(s + i + 16));
+		__m128i c = _mm_loadu_si128((const __m128i *)(const void *)(s + i + 32));
+		__m128i e = _mm_loadu_si128((const __m128i *)(const void *)(s + i + 48));
+		_mm_stream_si128((__m128i *)(void *)(d + i), a);
+		_mm_stream_si128((__m128i *)(void *)(d + i + 16), b);
+		_mm_stream_si128((__m128i *)(void *)(d + i + 32), c);
+		_mm_stream_si128((__m128i *)(void *)(d + i + 48), e);
+	}
+	_mm_sfence();
+	if (i < n) memcpy(d + i, s + i, n - i);
+}
+#endif
+
+#if defined(HAVE_NEON)
+static void copy_neon(void *dst, const void *src, size_t n) {
+	uint8_t *d = (uint8_t *)dst;
+	const uint8_t *s = (const uint8_t *)src;
+	size_t i = 0;
+	for (; i + 64 <= n; i += 64) {
+		uint8x16x4_t v = vld1q_u8_x4(s + i);
+		vst1q_u8_x4(d + i, v);
+	}
+	if (i < n) memcpy(d + i, s + i, n - i);
+}
+
+// Non-temporal pair stores (stnp) hint the destination should not be cached
+static void copy_nt(void *dst, const void *src, size_t n) {
+	uint8_t *d = (uint8_t *)dst;
+	const uint8_t *s = (const uint8_t *)src;
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		uint8x16_t a = vld1q_u8(s + i);
+		uint8x16_t b = vld1q_u8(s + i + 16);
+		__asm__ __volatile__("stnp %q0, %q1, [%2]" : : "w"(a), "w"(b), "r"(d + i) : "memory");
+	}
+	if (i < n) memcpy(d + i, s + i, n - i);
+}
+#endif
+
+// Copy strategies usable on this CPU
+static size_t copy_kernels(BwKernel *out) {
+	size_t n = 0;
+	out[n++] = (BwKernel){"memcpy", copy_libc};
+#if defined(HAVE_X86_INTRINSICS)
+	__builtin_cpu_init();
+	out[n++] = (BwKernel){"rep_movsb", copy_rep_movsb};
+	if (__builtin_cpu_supports("sse2")) out[n++] = (BwKernel){"sse", copy_sse};
+	if (__builtin_cpu_supports("avx")) out[n++] = (BwKernel){"avx", copy_avx};
+	if (__builtin_cpu_supports("avx512f")) out[n++] = (BwKernel){"avx512", copy_avx512};
+	if (__builtin_cpu_supports("sse2")) out[n++] = (BwKernel){"nt", copy_nt};
+#elif defined(HAVE_NEON)
+	out[n++] = (BwKernel){"neon", copy_neon};
+	out[n++] = (BwKernel){"nt", copy_nt};
+#endif
+	return n;
+}
+
+// Which of source/destination are resident in cache before each timed kernel call
+typedef enum CacheState {
+	STATE_HOT = 0, // both warmed by a previous call
+	STATE_SRC_HOT, // source cached, destination flushed
+	STATE_COLD,    // both flushed
+	STATE_COUNT
+} CacheState;
+
+static const char *cache_state_name(CacheState st) {
+	switch (st) {
+		case STATE_HOT: return "hot";
+		case STATE_SRC_HOT: return "src-hot";
+		case STATE_COLD: return "cold";
+		default: return "?";
+	}
+}
+
+// Evict [p, p+n) from all cache levels: clflush on x86, dc civac on AArch64,
+// otherwise by streaming through an eviction buffer larger than the last-level cache.
+static void flush_range(const void *p, size_t n, uint8_t *evict, size_t evict_bytes) {
+#if defined(HAVE_X86_INTRINSICS)
+	(void)evict;
+	(void)evict_bytes;
+	const uint8_t *c = (const uint8_t *)((uintptr_t)p & ~(uintptr_t)63);
+	const uint8_t *end = (const uint8_t *)p + n;
+	// inline asm rather than the SSE2 intrinsics so i386 builds need no -msse2
+	for (; c < end; c += 64) __asm__ __volatile__("clflush %0" : : "m"(*(const volatile uint8_t *)c) : "memory");
+	__asm__ __volatile__("mfence" ::: "memory");
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+	(void)evict;
+	(void)evict_bytes;
+	const uint8_t *c = (const uint8_t *)((uintptr_t)p & ~(uintptr_t)63);
+	const uint8_t *end = (const uint8_t *)p + n;
+	for (; c < end; c += 64) __asm__ __volatile__("dc civac, %0" : : "r"(c) : "memory");
+	__asm__ __volatile__("dsb ish" ::: "memory");
+#else
+	(void)p;
+	(void)n;
+	volatile uint8_t *e = evict;
+	for (size_t i = 0; i < evict_bytes; i += 64) e[i] = (uint8_t)(e[i] + 1u);
+#endif
+}
+
+// Bytes per ns (== GB/s) for one kernel call over n bytes in the given cache state, best of
+// opt->repeats rounds lasting about opt->target_ms each. src may be NULL for fill kernels.
+static double time_bw_kernel(const BwKernel *k, void *dst, const void *src, size_t n, CacheState st,
+		uint8_t *evict, size_t evict_bytes, const Options *opt) {
+	uint64_t target_ns = (uint64_t)opt->target_ms * 1000000ull;
+	double best = 0.0;
+	bool energy = energy_on(opt);
+	double line = (double)(opt->line_size ? opt->line_size : 64);
+	uint64_t e0[MAX_RAPL_ZONES], e1[MAX_RAPL_ZONES];
+	k->fn(dst, src, n); // warm / fault in
+	for (unsigned r = 0; r < opt->repeats; ++r) {
+		uint64_t busy = 0;
+		uint64_t bytes = 0;
+		// hot calls are too short for the counters; sample the whole round instead
+		if (energy && st == STATE_HOT) energy_read(e0);
+		uint64_t start = now_ns();
+		unsigned calls = 0;
+		do {
+			if (st == STATE_HOT) {
+				// batch calls so timer overhead does not dominate small sizes
+				unsigned batch = n < 4096 ? 64u : 1u;
+				uint64_t t0 = now_ns();
+				for (unsigned b = 0; b < batch; ++b) k->fn(dst, src, n);
+				uint64_t t1 = now_ns();
+				busy += t1 - t0;
+				bytes += (uint64_t)n * batch;
+			} else {
+				flush_range(dst, n, evict, evict_bytes);
+				if (st == STATE_COLD && src) flush_range(src, n, evict, evict_bytes);
+				if (energy) energy_read(e0);
+				uint64_t t0 = now_ns();
+				k->fn(dst, src, n);
+				uint64_t t1 = now_ns();
+				if (energy) {
+					energy_read(e1);
+					energy_add(e0, e1, (double)n / line);
+				}
+				busy += t1 - t0;
+				bytes += n;
+			}
+			calls++;
+		} while (now_ns() - start < target_ns && calls < (1u << 24));
+		if (energy && st == STATE_HOT) {
+			energy_read(e1);
+			energy_add(e0, e1, (double)bytes / line);
+		}
+		atomic_signal_fence(memory_order_seq_cst);
+		double bw = busy ? (double)bytes / (double)busy : 0.0;
+		if (bw > best) best = bw;
+	}
+	g_sink = dst;
+	return best;
+}
 
+// Report per-state throughput of each kernel, the fastest per size and the sizes where the
+// fastest kernel changes (crossovers). src == NULL runs the kernels as fills.
+static int run_bw_sweep(const Options *opt, const char *record, const BwKernel *kernels, size_t nk,
+		uint8_t *dst, const uint8_t *src, const size_t *sizes, size_t num_sizes) {
+	size_t evict_bytes = 0;
+	uint8_t *evict = NULL;
+#if !defined(HAVE_X86_INTRINSICS) && !(defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__)))
+	evict_bytes = 256ull << 20;
+	evict = (uint8_t *)malloc(evict_bytes);
+	if (!evict) {
+		fprintf(stderr, "Eviction buffer allocation failed\n");
+		return 1;
+	}
+	memset(evict, 1, evict_bytes);
+#endif
+	size_t *fastest = (size_t *)calloc(num_sizes, sizeof(size_t));
+	double *bws = (double *)calloc(num_sizes * nk, sizeof(double));
+	if (!fastest || !bws) {
+		free(fastest);
+		free(bws);
+		free(evict);
+		fprintf(stderr, "Allocation failed\n");
+		return 1;
+	}
+	bool energy = energy_on(opt);
+	if (!opt->json && opt->print_table) {
+		printf("# state\tsize_bytes");
+		for (size_t k = 0; k < nk; ++k) printf("\t%s_gbps", kernels[k].name);
+		printf("\tfastest");
+		for (size_t k = 0; energy && k < nk; ++k) {
+			for (int d = 0; d < ENERGY_DOMAINS; ++d) {
+				if (g_rapl_has[d]) printf("\t%s_%s_nj_per_line", kernels[k].name, energy_domain_name((EnergyDomain)d));
+			}
+		}
+		printf("\n");
+	}
+	for (int st = 0; st < STATE_COUNT; ++st) {
+		if (src == NULL && st == STATE_SRC_HOT) continue; // fills have no source
+		for (size_t i = 0; i < num_sizes; ++i) {
+			size_t n = sizes[i];
+			double best = -1.0;
+			if (opt->json) {
+				printf("{\"type\":\"%s\",\"state\":\"%s\",\"size_bytes\":%zu", record, cache_state_name((CacheState)st), n);
+			} else if (opt->print_table) {
+				printf("%s\t%zu", cache_state_name((CacheState)st), n);
+			}
+			double nj[8][ENERGY_DOMAINS];
+			for (size_t k = 0; k < nk; ++k) {
+				EnergyTotals e0 = g_energy;
+				double bw = time_bw_kernel(&kernels[k], dst, src, n, (CacheState)st, evict, evict_bytes, opt);
+				energy_since(&e0, nj[k]);
+				bws[i * nk + k] = bw;
+				if (bw > best) {
+					best = bw;
+					fastest[i] = k;
+				}
+				if (opt->json) printf(",\"%s_gbps\":%.3f", kernels[k].name, bw);
+				else if (opt->print_table) printf("\t%.3f", bw);
+			}
+			if (opt->json) printf(",\"fastest\":\"%s\"", kernels[fastest[i]].name);
+			else if (opt->print_table) printf("\t%s", kernels[fastest[i]].name);
+			for (size_t k = 0; energy && k < nk; ++k) {
+				for (int d = 0; d < ENERGY_DOMAINS; ++d) {
+					if (!g_rapl_has[d]) continue;
+					if (opt->json) printf(",\"%s_%s_nj_per_line\":%.4f", kernels[k].name, energy_domain_name((EnergyDomain)d), nj[k][d]);
+					else if (opt->print_table) printf("\t%.4f", nj[k][d]);
+				}
+			}
+			if (opt->json) printf("}\n");
+			else if (opt->print_table) printf("\n");
+			fflush(stdout);
+		}
+		// crossovers with 5% hysteresis so near-ties do not flip the winner back and forth
+		size_t winner = num_sizes ? fastest[0] : 0;
+		for (size_t i = 1; i < num_sizes; ++i) {
+			if (fastest[i] == winner || bws[i * nk + winner] >= 0.95 * bws[i * nk + fastest[i]]) continue;
+			if (opt->json) {
+				printf("{\"type\":\"%s_crossover\",\"state\":\"%s\",\"size_bytes\":%zu,\"from\":\"%s\",\"to\":\"%s\"}\n",
+					record, cache_state_name((CacheState)st), sizes[i], kernels[winner].name, kernels[fastest[i]].name);
+			} else {
+				char buf[32];
+				printf("# crossover (%s) at %s: %s -> %s\n", cache_state_name((CacheState)st), human_size(sizes[i], buf, sizeof(buf)),
+					kernels[winner].name, kernels[fastest[i]].name);
+			}
+			winner = fastest[i];
+		}
+	}
+	free(bws);
+	free(fastest);
+	free(evict);
+	return 0;
+}
+
+// Copy throughput of each strategy for every size, with source/destination hot, source-only
+// hot, or both cold.
+static int run_memcpy_mode(const Options *opt, Workspace *ws, const size_t *sizes, size_t num_sizes) {
+	uint8_t *dst = NULL;
+	if (posix_memalign((void **)&dst, 4096, ws->bytes) != 0 || !dst) {
+		fprintf(stderr, "Destination allocation of %zu bytes failed\n", ws->bytes);
+		return 1;
+	}
+	memset(dst, 0, ws->bytes);
+	for (size_t i = 0; i < ws->bytes; i += 64) ws->base[i] = (uint8_t)i;
+	BwKernel kernels[8];
+	size_t nk = copy_kernels(kernels);
+	if (opt->json) {
+		printf("{\"type\":\"config\",\"mode\":\"%s\",\"target_ms\":%u,\"repeats\":%u}\n", mode_name(opt->mode), opt->target_ms, opt->repeats);
+	} else if (opt->print_table) {
+		printf("# Copy throughput in GB/s per strategy (target=%ums, best of %u)\n", opt->target_ms, opt->repeats);
+	}
+	int rc = run_bw_sweep(opt, "memcpy", kernels, nk, dst, ws->base, sizes, num_sizes);
+	free(dst);
+	return rc;
+}
+
+// ---------------------------------------------------------------------------
+// Zeroing primitives (fill kernels: src is ignored)
+// ---------------------------------------------------------------------------
+
+static void zero_memset(void *dst, const void *src, size_t n) {
+	(void)src;
+	memset(dst, 0, n);
+}
+
+#if defined(HAVE_X86_INTRINSICS)
+static void zero_rep_stosb(void *dst, const void *src, size_t n) {
+	(void)src;
+	__asm__ __volatile__("rep stosb" : "+D"(dst), "+c"(n) : "a"(0) : "memory");
+}
+
+// AMD clzero: zeroes one 64-byte line without reading it
+static void zero_clzero(void *dst, const void *src, size_t n) {
+	(void)src;
+	uint8_t *d = (uint8_t *)dst;
+	size_t head = (64 - ((uintptr_t)d & 63)) & 63;
+	if (head > n) head = n;
+	memset(d, 0, head);
+	size_t i = head;
+	for (; i + 64 <= n; i += 64) {
+		__asm__ __volatile__(".byte 0x0f, 0x01, 0xfc" : : "a"(d + i) : "memory");
+	}
+	__asm__ __volatile__("sfence" ::: "memory");
+	if (i < n) memset(d + i, 0, n - i);
+}
+
+static bool cpu_has_clzero(void) {
+	unsigned a, b, c, d;
+	if (!__get_cpuid(0x80000000u, &a, &b, &c, &d) || a < 0x80000008u) return false;
+	if (!__get_cpuid(0x80000008u, &a, &b, &c, &d)) return false;
+	return (b & 1u) != 0;
+}
+
+TARGET_SSE2 static void zero_nt(void *dst, const void *src, size_t n) {
+	(void)src;
+	uint8_t *d = (uint8_t *)dst;
+	size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+	if (head > n) head = n;
+	memset(d, 0, head);
+	size_t i = head;
+	__m128i z = _mm_setzero_si128();
+	for (; i + 64 <= n; i += 64) {
+		_mm_stream_si128((__m128i *)(void *)(d + i), z);
+		_mm_stream_si128((__m128i *)(void *)(d + i + 16), z);
+		_mm_stream_si128((__m128i *)(void *)(d + i + 32), z);
+		_mm_stream_si128((__m128i *)(void *)(d + i + 48), z);
+	}
+	_mm_sfence();
+	if (i < n) memset(d + i, 0, n - i);
+}
+#endif
+
+#if defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+// DC ZVA block size in bytes, 0 when the instruction is prohibited
+static size_t dc_zva_block(void) {
+	uint64_t v;
+	__asm__ __volatile__("mrs %0, dczid_el0" : "=r"(v));
+	if (v & 16u) return 0;
+	return (size_t)4u << (v & 15u);
+}
+
+static void zero_dc_zva(void *dst, const void *src, size_t n) {
+	(void)src;
+	size_t block = dc_zva_block();
+	uint8_t *d = (uint8_t *)dst;
+	size_t head = (block - ((uintptr_t)d & (block - 1))) & (block - 1);
+	if (head > n) head = n;
+	memset(d, 0, head);
+	size_t i = head;
+	for (; i + block <= n; i += block) {
+		__asm__ __volatile__("dc zva, %0" : : "r"(d + i) : "memory");
+	}
+	if (i < n) memset(d + i, 0, n - i);
+}
+
+static void zero_nt(void *dst, const void *src, size_t n) {
+	(void)src;
+	uint8_t *d = (uint8_t *)dst;
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__asm__ __volatile__("stnp xzr, xzr, [%0]" : : "r"(d + i) : "memory");
+	}
+	if (i < n) memset(d + i, 0, n - i);
+}
+#endif
+
+// Zeroing primitives usable on this CPU
+static size_t zero_kernels(BwKernel *out) {
+	size_t n = 0;
+	out[n++] = (BwKernel){"memset", zero_memset};
+#if defined(HAVE_X86_INTRINSICS)
+	__builtin_cpu_init();
+	out[n++] = (BwKernel){"rep_stosb", zero_rep_stosb};
+	if (cpu_has_clzero()) out[n++] = (BwKernel){"clzero", zero_clzero};
+	if (__builtin_cpu_supports("sse2")) out[n++] = (BwKernel){"nt", zero_nt};
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+	if (dc_zva_block() != 0) out[n++] = (BwKernel){"dc_zva", zero_dc_zva};
+	out[n++] = (BwKernel){"nt", zero_nt};
+#endif
+	return n;
+}
+
+// Mean ns per access of one full pass over the (already built) hot cycle after running
+// kernel k over n bytes of dst; k == NULL measures the undisturbed pass.
+static double hot_pass_after(const BwKernel *k, void *dst, size_t n, void *hot, size_t hot_nodes, unsigned trials) {
+	uint64_t total = 0;
+	for (unsigned t = 0; t < trials; ++t) {
+		(void)chase(hot, hot_nodes * 2); // bring the hot set back in
+		if (k) k->fn(dst, NULL, n);
+		atomic_signal_fence(memory_order_seq_cst);
+		uint64_t t0 = now_ns();
+		(void)chase(hot, hot_nodes);
+		uint64_t t1 = now_ns();
+		atomic_signal_fence(memory_order_seq_cst);
+		total += t1 - t0;
+	}
+	return (double)total / ((double)trials * (double)hot_nodes);
+}
+
+// Zeroing throughput per primitive (hot and cold destination), then the pollution each
+// primitive leaves behind: hot-set chase latency right after zeroing each size.
+static int run_zero_mode(const Options *opt, Workspace *ws, const size_t *sizes, size_t num_sizes) {
+	size_t hot_bytes = opt->hot_bytes;
+	if (hot_bytes > ws->bytes) hot_bytes = ws->bytes;
+	uint8_t *dst = NULL;
+	if (posix_memalign((void **)&dst, 4096, ws->bytes) != 0 || !dst) {
+		fprintf(stderr, "Destination allocation of %zu bytes failed\n", ws->bytes);
+		return 1;
+	}
+	memset(dst, 1, ws->bytes);
+	BwKernel kernels[8];
+	size_t nk = zero_kernels(kernels);
+	if (opt->json) {
+		printf("{\"type\":\"config\",\"mode\":\"%s\",\"hot_bytes\":%zu,\"target_ms\":%u,\"repeats\":%u}\n", mode_name(opt->mode), hot_bytes, opt->target_ms, opt->repeats);
+	} else if (opt->print_table) {
+		printf("# Zeroing throughput in GB/s per primitive (target=%ums, best of %u)\n", opt->target_ms, opt->repeats);
+	}
+	int rc = run_bw_sweep(opt, "zero", kernels, nk, dst, NULL, sizes, num_sizes);
+	if (rc != 0) {
+		free(dst);
+		return rc;
+	}
+
+	size_t hot_nodes = nodes_for_size(hot_bytes, opt->node_stride);
+	build_cycle_pattern(ws->base, hot_nodes, opt->node_stride, ws->perm, &ws->rng, PATTERN_RANDOM, 0, 0);
+	unsigned trials = (opt->repeats ? opt->repeats : 1) * 8u;
+	double base_ns = hot_pass_after(NULL, dst, 0, ws->base, hot_nodes, trials);
+	char buf[32];
+	if (opt->json) {
+		printf("{\"type\":\"zero_pollution_baseline\",\"hot_bytes\":%zu,\"ns_per_access\":%.3f}\n", hot_bytes, base_ns);
+	} else if (opt->print_table) {
+		printf("\n# Pollution: hot-set (%s, random) chase ns/access right after zeroing size_bytes; undisturbed %.3f\n",
+			human_size(hot_bytes, buf, sizeof(buf)), base_ns);
+		printf("# size_bytes");
+		for (size_t k = 0; k < nk; ++k) printf("\t%s_ns", kernels[k].name);
+		printf("\n");
+	}
+	for (size_t i = 0; i < num_sizes; ++i) {
+		size_t n = sizes[i];
+		if (opt->json) printf("{\"type\":\"zero_pollution\",\"size_bytes\":%zu", n);
+		else if (opt->print_table) printf("%zu", n);
+		for (size_t k = 0; k < nk; ++k) {
+			double ns = hot_pass_after(&kernels[k], dst, n, ws->base, hot_nodes, trials);
+			if (opt->json) printf(",\"%s_ns\":%.3f", kernels[k].name, ns);
+			else if (opt->print_table) printf("\t%.3f", ns);
+		}
+		if (opt->json) printf("}\n");
+		else if (opt->print_table) printf("\n");
+		fflush(stdout);
+	}
+	free(dst);
+	return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Blocking-factor advisor: derive tile sizes from cache levels, confirm with tiled kernels
+// ---------------------------------------------------------------------------
+
+static size_t pow2_floor(size_t v) {
+	size_t p = 1;
+	while ((p << 1) > p && (p << 1) <= v) p <<= 1;
+	return p;
+}
+
+// Integer square root (Newton's method, no libm)
+static size_t isqrt_size(size_t v) {
+	if (v < 2) return v;
+	size_t r = v / 2;
+	size_t next = (r + v / r) / 2;
+	while (next < r) {
+		r = next;
+		next = (r + v / r) / 2;
+	}
+	return r;
+}
+
+// Out-of-place transpose of an n x n matrix in t x t tiles
+NOINLINE static void tile_transpose(double *dst, const double *src, size_t n, size_t t) {
+	for (size_t ii = 0; ii < n; ii += t) {
+		size_t ie = ii + t < n ? ii + t : n;
+		for (size_t jj = 0; jj < n; jj += t) {
+			size_t je = jj + t < n ? jj + t : n;
+			for (size_t i = ii; i < ie; ++i) {
+				for (size_t j = jj; j < je; ++j) dst[j * n + i] = src[i * n + j];
+			}
+		}
+	}
+}
+
+// C += A * B (n x n) blocked by kc (shared dimension) and nc (columns of B/C); the
+// inner i-k-j loop streams a kc x nc panel of B per row of A.
+NOINLINE static void tile_gemm(double *c, const double *a, const double *b, size_t n, size_t kc, size_t nc) {
+	for (size_t jc = 0; jc < n; jc += nc) {
+		size_t je = jc + nc < n ? jc + nc : n;
+		for (size_t pc = 0; pc < n; pc += kc) {
+			size_t pe = pc + kc < n ? pc + kc : n;
+			for (size_t i = 0; i < n; ++i) {
+				double *crow = c + i * n;
+				for (size_t p = pc; p < pe; ++p) {
+					double av = a[i * n + p];
+					const double *brow = b + p * n;
+					for (size_t j = jc; j < je; ++j) crow[j] += av * brow[j];
+				}
+			}
+		}
+	}
+}
+
+// 7-point 3D Jacobi sweep over an n^3 grid, blocked in y and x; z streams innermost per tile
+NOINLINE static void tile_stencil(double *out, const double *in, size_t n, size_t by, size_t bx) {
+	size_t plane = n * n;
+	for (size_t yy = 1; yy < n - 1; yy += by) {
+		size_t ye = yy + by < n - 1 ? yy + by : n - 1;
+		for (size_t xx = 1; xx < n - 1; xx += bx) {
+			size_t xe = xx + bx < n - 1 ? xx + bx : n - 1;
+			for (size_t z = 1; z < n - 1; ++z) {
+				for (size_t y = yy; y < ye; ++y) {
+					size_t row = z * plane + y * n;
+					for (size_t x = xx; x < xe; ++x) {
+						size_t k = row + x;
+						out[k] = 0.4 * in[k] + 0.1 * (in[k - 1] + in[k + 1] + in[k - n] + in[k + n] + in[k - plane] + in[k + plane]);
+					}
+				}
+			}
+		}
+	}
+}
+
+typedef enum TileKernel { TILE_TRANSPOSE = 0, TILE_GEMM, TILE_STENCIL } TileKernel;
+
+// Best-of-repeats wall time in ms of one kernel invocation with tile (t1, t2)
+static double time_tile(TileKernel k, double *x, double *y, double *z, size_t n, size_t t1, size_t t2, unsigned repeats) {
+	double best = 1e300;
+	for (unsigned r = 0; r < (repeats ? repeats : 1); ++r) {
+		uint64_t t0 = now_ns();
+		switch (k) {
+			case TILE_TRANSPOSE: tile_transpose(y, x, n, t1); break;
+			case TILE_GEMM: tile_gemm(z, x, y, n, t1, t2); break;
+			case TILE_STENCIL: tile_stencil(y, x, n, t1, t2); break;
+		}
+		uint64_t t = now_ns() - t0;
+		double ms = (double)t / 1e6;
+		if (ms < best) best = ms;
+	}
+	g_sink = y;
+	return best;
+}
+
+// Evaluate a grid of tiles around the prediction, report each and the best
+static void advise_tile(const Options *opt, TileKernel k, const char *name, double *x, double *y, double *z, size_t n,
+		size_t pred1, size_t pred2, const size_t *grid1, size_t ng1, const size_t *grid2, size_t ng2) {
+	double best_ms = 1e300;
+	size_t best1 = pred1, best2 = pred2;
+	for (size_t a = 0; a < ng1; ++a) {
+		for (size_t b = 0; b < ng2; ++b) {
+			size_t t1 = grid1[a], t2 = grid2[b];
+			if (t1 > n || t2 > n) continue;
+			double ms = time_tile(k, x, y, z, n, t1, t2, opt->repeats);
+			if (opt->json) {
+				printf("{\"type\":\"tile\",\"kernel\":\"%s\",\"n\":%zu,\"tile1\":%zu,\"tile2\":%zu,\"ms\":%.3f}\n", name, n, t1, t2, ms);
+			} else if (opt->print_table) {
+				printf("%s\t%zu\t%zu\t%zu\t%.3f\n", name, n, t1, t2, ms);
+			}
+			if (ms < best_ms) {
+				best_ms = ms;
+				best1 = t1;
+				best2 = t2;
+			}
+		}
+		fflush(stdout);
+	}
+	// timed after the grid so it runs on warm pages like the grid points
+	double pred_ms = time_tile(k, x, y, z, n, pred1, pred2, opt->repeats);
+	if (pred_ms < best_ms) {
+		best_ms = pred_ms;
+		best1 = pred1;
+		best2 = pred2;
+	}
+	if (opt->json) {
+		printf("{\"type\":\"tile_advice\",\"kernel\":\"%s\",\"predicted\":[%zu,%zu],\"predicted_ms\":%.3f,\"best\":[%zu,%zu],\"best_ms\":%.3f}\n",
+			name, pred1, pred2, pred_ms, best1, best2, best_ms);
+	} else if (pred2 == 0) {
+		printf("# %s: predicted %zu (%.2f ms), best %zu (%.2f ms), predicted is %.0f%% slower\n",
+			name, pred1, pred_ms, best1, best_ms, (pred_ms / best_ms - 1.0) * 100.0);
+	} else {
+		printf("# %s: predicted %zux%zu (%.2f ms), best %zux%zu (%.2f ms), predicted is %.0f%% slower\n",
+			name, pred1, pred2, pred_ms, best1, best2, best_ms, (pred_ms / best_ms - 1.0) * 100.0);
+	}
+}
+
+// Derive candidate tiles from the detected levels, then confirm over a grid of tile sizes
+static int run_tile_mode(const Options *opt, Workspace *ws, const size_t *sizes, size_t num_sizes) {
+	CacheLevels lv;
+	if (measure_levels(opt, ws, sizes, num_sizes, &lv) != 0) return 1;
+	size_t l1 = lv.count > 0 ? lv.size_bytes[0] : 32u << 10;
+	size_t l2 = lv.count > 1 ? lv.size_bytes[1] : l1 * 16;
+	size_t l3 = lv.count > 2 ? lv.size_bytes[2] : l2 * 16;
+	// transpose: source and destination tiles share L1
+	size_t t_pred = pow2_floor(isqrt_size(l1 / 2 / (2 * sizeof(double))));
+	// GEMM: the kc x nc panel of B stays in L2 while rows of A stream through it
+	size_t g_n = 512;
+	size_t nc_pred = 256;
+	size_t kc_pred = pow2_floor(l2 / 2 / (nc_pred * sizeof(double)));
+	if (kc_pred < 8) kc_pred = 8;
+	if (kc_pred > g_n) kc_pred = g_n;
+	// stencil: three z-planes of a by x bx tile stay in L2
+	size_t s_pred = pow2_floor(isqrt_size(l2 / 2 / (3 * sizeof(double))));
+	size_t t_n = 2000; // not a power of two, to avoid pathological set conflicts
+	size_t s_n = 160;
+	(void)l3;
+
+	size_t elems = t_n * t_n;
+	if (g_n * g_n > elems) elems = g_n * g_n;
+	if (s_n * s_n * s_n > elems) elems = s_n * s_n * s_n;
+	double *x = (double *)malloc(elems * sizeof(double));
+	double *y = (double *)malloc(elems * sizeof(double));
+	double *z = (double *)malloc(elems * sizeof(double));
+	if (!x || !y || !z) {
+		fprintf(stderr, "Tile kernel allocation failed\n");
+		free(x);
+		free(y);
+		free(z);
+		return 1;
+	}
+	for (size_t i = 0; i < elems; ++i) {
+		x[i] = (double)(i & 1023) * 0.001;
+		y[i] = 0.0;
+		z[i] = 0.0;
+	}
+	char b1[32], b2[32], b3[32];
+	if (opt->json) {
+		printf("{\"type\":\"config\",\"mode\":\"%s\",\"l1_bytes\":%zu,\"l2_bytes\":%zu,\"l3_bytes\":%zu}\n", mode_name(opt->mode), l1, l2, l3);
+	} else {
+		printf("# Blocking advisor from levels L1=%s L2=%s L3=%s\n", human_size(l1, b1, sizeof(b1)), human_size(l2, b2, sizeof(b2)), human_size(l3, b3, sizeof(b3)));
+		if (opt->print_table) printf("# kernel\tn\ttile1\ttile2\tms\n");
+	}
+	const size_t t_grid[] = {4, 8, 16, 32, 64, 128, 256};
+	const size_t one[] = {0};
+	advise_tile(opt, TILE_TRANSPOSE, "transpose", x, y, z, t_n, t_pred, 0, t_grid, sizeof(t_grid) / sizeof(t_grid[0]), one, 1);
+	const size_t kc_grid[] = {16, 32, 64, 128, 256, 512};
+	const size_t nc_grid[] = {64, 128, 256, 512};
+	advise_tile(opt, TILE_GEMM, "gemm", x, y, z, g_n, kc_pred, nc_pred, kc_grid, sizeof(kc_grid) / sizeof(kc_grid[0]), nc_grid, sizeof(nc_grid) / sizeof(nc_grid[0]));
+	const size_t s_grid[] = {8, 16, 32, 64, 160};
+	advise_tile(opt, TILE_STENCIL, "stencil", x, y, z, s_n, s_pred, s_pred, s_grid, sizeof(s_grid) / sizeof(s_grid[0]), s_grid, sizeof(s_grid) / sizeof(s_grid[0]));
+	free(x);
+	free(y);
+	free(z);
+	return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Cache inclusion policy: inclusive, non-inclusive or exclusive/victim L3
+// ---------------------------------------------------------------------------
+
+// Cache sizes from --cache-sizes, else sysfs, else a silent latency sweep
+static int known_cache_sizes(const Options *opt, Workspace *ws, const size_t *sizes, size_t num_sizes, size_t *out, size_t cap) {
+	for (size_t i = 0; i < cap; ++i) out[i] = 0;
+	if (opt->num_cache_sizes > 0) {
+		for (size_t i = 0; i < opt->num_cache_sizes && i < cap; ++i) out[i] = opt->cache_sizes[i];
+		return 0;
+	}
+	if (read_sysfs_cache_sizes(opt->cpu >= 0 ? opt->cpu : current_cpu(), out, cap) >= 3) return 0;
+	CacheLevels lv;
+	if (measure_levels(opt, ws, sizes, num_sizes, &lv) != 0) return 1;
+	for (size_t i = 0; i < lv.count && i < cap; ++i) out[i] = lv.size_bytes[i];
+	return 0;
+}
+
+// Time one pass over an already-built cycle, ns per access
+static double time_one_pass(void *head, size_t nodes) {
+	atomic_signal_fence(memory_order_seq_cst);
+	uint64_t t0 = now_ns();
+	(void)chase(head, nodes);
+	uint64_t t1 = now_ns();
+	atomic_signal_fence(memory_order_seq_cst);
+	return (double)(t1 - t0) / (double)nodes;
+}
+
+typedef struct Streamer {
+	const uint8_t *buf;
+	size_t bytes;
+	size_t stride;
+	unsigned passes;
+	int cpu;
+} Streamer;
+
+// Read every line of a buffer (runs on a second core to evict the shared L3 only)
+static void *stream_worker(void *arg) {
+	Streamer *st = (Streamer *)arg;
+	if (st->cpu >= 0) (void)pin_to_cpu(st->cpu);
+	uint64_t sum = 0;
+	for (unsigned p = 0; p < st->passes; ++p) {
+		for (size_t i = 0; i < st->bytes; i += st->stride) sum += ((const volatile uint8_t *)st->buf)[i];
+	}
+	g_sink = (void *)(uintptr_t)sum;
+	return NULL;
+}
+
+// Warm a set that fits in L2, evict the L3 from a core sharing it, and see where the set is
+// re-found (inclusive L3 back-invalidates it). Then sweep around L3 capacity to see whether
+// L2 and L3 add up (exclusive / victim L3).
+static int run_inclusion_mode(const Options *opt, Workspace *ws, const size_t *sizes, size_t num_sizes) {
+	size_t cs[8];
+	if (known_cache_sizes(opt, ws, sizes, num_sizes, cs, 8) != 0) return 1;
+	size_t l1 = cs[0], l2 = cs[1], l3 = cs[2];
+	if (l1 == 0 || l2 == 0 || l3 == 0) {
+		fprintf(stderr, "inclusion mode needs L1, L2 and L3 sizes; pass --cache-sizes L1,L2,L3\n");
+		return 1;
+	}
+	size_t stride = opt->node_stride;
+	size_t line = opt->line_size;
+	size_t evict_bytes = l3 * 2;
+	size_t sweep_hi = (l2 + l3) + (l2 + l3) / 2;
+	size_t need = evict_bytes > sweep_hi ? evict_bytes : sweep_hi;
+	if (need > ws->bytes) {
+		char b1[32], b2[32];
+		fprintf(stderr, "inclusion mode needs a %s buffer (have %s); raise --max-bytes\n", human_size(need, b1, sizeof(b1)), human_size(ws->bytes, b2, sizeof(b2)));
+		return 1;
+	}
+	uint8_t *small = NULL;
+	size_t small_bytes = l2 / 2;
+	if (posix_memalign((void **)&small, 4096, small_bytes) != 0 || !small) {
+		fprintf(stderr, "Allocation failed\n");
+		return 1;
+	}
+	memset(small, 0, small_bytes);
+	size_t small_nodes = nodes_for_size(small_bytes, stride);
+	size_t *order = (size_t *)malloc(small_nodes * sizeof(size_t));
+	if (!order) {
+		free(small);
+		fprintf(stderr, "Allocation failed\n");
+		return 1;
+	}
+	build_cycle_pattern(small, small_nodes, stride, order, &ws->rng, PATTERN_RANDOM, 0, 0);
+
+	// reference latencies: L2 hit (warm small set) and memory (cycle 4x L3, or the largest fit)
+	(void)chase(small, small_nodes * 4);
+	double l2_ns = time_one_pass(small, small_nodes);
+	for (int k = 0; k < 4; ++k) {
+		double v = time_one_pass(small, small_nodes);
+		if (v < l2_ns) l2_ns = v;
+	}
+	size_t mem_bytes = l3 * 4 < ws->bytes ? l3 * 4 : ws->bytes;
+	double mem_ns = measure_ns_per_access(ws, mem_bytes, stride, opt, NULL);
+	size_t l3_probe = l3 / 2;
+	double l3_ns = measure_ns_per_access(ws, l3_probe, stride, opt, NULL);
+
+	// cross-core eviction
+	int cpus[2] = {-1, -1};
+	if (opt->num_cpus >= 2) {
+		cpus[0] = opt->cpus[0];
+		cpus[1] = opt->cpus[1];
+	} else {
+		CpuInfo *topo = (CpuInfo *)calloc(MAX_CPUS, sizeof(CpuInfo));
+		int *list = (int *)calloc(MAX_CPUS, sizeof(int));
+		if (topo && list && placement_cpus(topo, read_topology(topo, MAX_CPUS), PLACEMENT_SAME_L3, list, MAX_CPUS) >= 2) {
+			cpus[0] = list[0];
+			cpus[1] = list[1];
+		}
+		free(list);
+		free(topo);
+	}
+	double refound_ns = -1.0;
+	const char *refound_at = "untested";
+	if (cpus[1] >= 0) {
+		AffinityMask prev;
+		affinity_save(&prev);
+		(void)pin_to_cpu(cpus[0]);
+		double best = 1e300;
+		for (unsigned r = 0; r < (opt->repeats ? opt->repeats : 1); ++r) {
+			(void)chase(small, small_nodes * 4);
+			Streamer st = {ws->base, evict_bytes, line, 2, cpus[1]};
+			pthread_t th;
+			if (pthread_create(&th, NULL, stream_worker, &st) != 0) break;
+			pthread_join(th, NULL);
+			double v = time_one_pass(small, small_nodes);
+			if (v < best) best = v;
+		}
+		refound_ns = best;
+		// nearest reference latency on a log scale
+		double dl2 = fabs(log(refound_ns / l2_ns));
+		double dl3 = fabs(log(refound_ns / l3_ns));
+		double dmem = fabs(log(refound_ns / mem_ns));
+		refound_at = dl2 <= dl3 && dl2 <= dmem ? "L2" : (dl3 <= dmem ? "L3" : "memory");
+		affinity_restore(&prev);
+	}
+
+	// capacity sweep from L3/2 to 1.5x (L2 + L3): last size still well below memory latency
+	double mid = sqrt(l3_ns * mem_ns);
+	size_t effective = 0;
+	if (!opt->json && opt->print_table) {
+		printf("# Inclusion probe (L1=%zu L2=%zu L3=%zu bytes, CPUs %d,%d)\n", l1, l2, l3, cpus[0], cpus[1]);
+		printf("# size_bytes\tlatency_ns_per_access\n");
+	}
+	const unsigned steps = 16;
+	for (unsigned k = 0; k <= steps; ++k) {
+		size_t wsb = l3 / 2 + (size_t)((double)(sweep_hi - l3 / 2) * k / steps);
+		wsb = wsb / stride * stride;
+		double ns = measure_ns_per_access(ws, wsb, stride, opt, NULL);
+		if (ns < mid && (effective == 0 || wsb > effective)) effective = wsb;
+		if (opt->json) {
+			printf("{\"type\":\"inclusion_sample\",\"size_bytes\":%zu,\"ns_per_access\":%.3f}\n", wsb, ns);
+		} else if (opt->print_table) {
+			printf("%zu\t%.3f\n", wsb, ns);
+		}
+		fflush(stdout);
+	}
+
+	const char *policy;
+	if (effective >= l3 + l2 / 2) {
+		policy = "exclusive/victim";
+	} else if (cpus[1] < 0) {
+		policy = "inclusive or non-inclusive (cross-core test needs two CPUs sharing L3)";
+	} else if (strcmp(refound_at, "L2") == 0) {
+		policy = "non-inclusive";
+	} else if (strcmp(refound_at, "memory") == 0) {
+		policy = "inclusive"; // back-invalidated out of L2 by the other core's L3 evictions
+	} else {
+		// dropped from L2 but still in L3: fits a non-inclusive L3 as well, so no verdict
+		policy = "inconclusive (re-found at L3)";
+	}
+	char b1[32], b2[32];
+	if (opt->json) {
+		printf("{\"type\":\"inclusion\",\"policy\":\"%s\",\"refound_at\":\"%s\",\"refound_ns\":%.3f,\"l2_ns\":%.3f,\"l3_ns\":%.3f,\"mem_ns\":%.3f,\"effective_l2_l3_bytes\":%zu,\"nominal_l2_plus_l3_bytes\":%zu}\n",
+			policy, refound_at, refound_ns, l2_ns, l3_ns, mem_ns, effective, l2 + l3);
+	} else {
+		printf("\nL3 inclusion policy: %s\n", policy);
+		if (refound_ns > 0.0) {
+			printf("- L2-resident set after cross-core L3 eviction re-found at %s (%.2f ns; L2 %.2f, L3 %.2f, memory %.2f)\n", refound_at, refound_ns, l2_ns, l3_ns, mem_ns);
+		}
+		printf("- effective L2+L3 capacity ~ %s (L2 + L3 = %s)\n", human_size(effective, b1, sizeof(b1)), human_size(l2 + l3, b2, sizeof(b2)));
+	}
+	free(order);
+	free(small);
+	return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Replacement policy identification: same-set access sequences vs simulated policies
+// ---------------------------------------------------------------------------
+
+// Geometry of one data/unified cache level as reported by sysfs
+typedef struct CacheGeometry {
+	unsigned level;
+	size_t size_bytes;
+	size_t ways;
+	size_t sets;
+	size_t line;
+} CacheGeometry;
+
+// Data/unified cache geometry of one CPU; returns the number of levels found
+static size_t read_sysfs_cache_geometry(int cpu, CacheGeometry *out, size_t cap) {
+	size_t n = 0;
+#if defined(__linux__)
+	if (cpu < 0) cpu = 0;
+	for (int idx = 0; idx < 16 && n < cap; ++idx) {
+		char path[256];
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, idx);
+		long level = read_long_file(path, -1);
+		if (level < 0) break;
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/type", cpu, idx);
+		FILE *f = fopen(path, "r");
+		char type[32] = "";
+		if (f) {
+			if (!fgets(type, sizeof(type), f)) type[0] = '\0';
+			fclose(f);
+		}
+		if (strncmp(type, "Instruction", 11) == 0) continue;
+		CacheGeometry g;
+		g.level = (unsigned)level;
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/ways_of_associativity", cpu, idx);
+		long ways = read_long_file(path, 0);
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/number_of_sets", cpu, idx);
+		long sets = read_long_file(path, 0);
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/coherency_line_size", cpu, idx);
+		long line = read_long_file(path, 0);
+		g.ways = ways > 0 ? (size_t)ways : 0;
+		g.sets = sets > 0 ? (size_t)sets : 0;
+		g.line = line > 0 ? (size_t)line : 0;
+		g.size_bytes = g.ways * g.sets * g.line;
+		out[n++] = g;
+	}
+#else
+	(void)cpu;
+	(void)out;
+	(void)cap;
+#endif
+	return n;
+}
+
+// Candidate policies, simulated on the same sequences the hardware runs
+typedef enum ReplPolicy {
+	REPL_LRU = 0,
+	REPL_PLRU,     // tree pseudo-LRU (bit-PLRU / MRU-bits when ways is not a power of two)
+	REPL_SRRIP,    // 2-bit re-reference prediction, insert at distant-1 (QLRU-like)
+	REPL_ADAPTIVE, // bimodal insertion (BRRIP), what set-dueling picks under thrash
+	REPL_COUNT
+} ReplPolicy;
+
+static const char *repl_policy_name(ReplPolicy p) {
+	switch (p) {
+		case REPL_LRU: return "LRU";
+		case REPL_PLRU: return "tree-PLRU";
+		case REPL_SRRIP: return "SRRIP/QLRU";
+		case REPL_ADAPTIVE: return "adaptive (BRRIP/DRRIP-like)";
+		default: return "unknown";
+	}
+}
+
+#define REPL_MAX_WAYS 64
+#define REPL_MAX_SEQ (8 * REPL_MAX_WAYS) // longest sequence: hot_scan, 4 x (2 x w/2 hot + w scan)
+
+typedef struct ReplSim {
+	ReplPolicy policy;
+	size_t ways;
+	size_t tag[REPL_MAX_WAYS];   // line id + 1, 0 = empty
+	unsigned state[REPL_MAX_WAYS]; // LRU age / MRU bit / RRPV
+	unsigned tree[REPL_MAX_WAYS];  // tree-PLRU node bits (1 = victim on the right)
+	unsigned inserts;
+} ReplSim;
+
+static bool is_pow2(size_t v) { return v != 0 && (v & (v - 1)) == 0; }
+
+static void repl_touch(ReplSim *s, size_t way) {
+	switch (s->policy) {
+		case REPL_LRU:
+			for (size_t i = 0; i < s->ways; ++i) {
+				if (s->tag[i] && s->state[i] < s->state[way]) s->state[i]++;
+			}
+			s->state[way] = 0;
+			break;
+		case REPL_PLRU:
+			if (is_pow2(s->ways)) {
+				size_t node = 1, lo = 0, hi = s->ways;
+				while (hi - lo > 1) {
+					size_t mid = (lo + hi) / 2;
+					if (way < mid) {
+						s->tree[node] = 1;
+						node = 2 * node;
+						hi = mid;
+					} else {
+						s->tree[node] = 0;
+						node = 2 * node + 1;
+						lo = mid;
+					}
+				}
+			} else {
+				s->state[way] = 1;
+				bool all = true;
+				for (size_t i = 0; i < s->ways; ++i) all = all && s->state[i];
+				if (all) {
+					for (size_t i = 0; i < s->ways; ++i) s->state[i] = 0;
+					s->state[way] = 1;
+				}
+			}
+			break;
+		default:
+			s->state[way] = 0; // RRIP hit promotion
+			break;
+	}
+}
+
+static size_t repl_victim(ReplSim *s) {
+	for (size_t i = 0; i < s->ways; ++i) {
+		if (!s->tag[i]) return i;
+	}
+	switch (s->policy) {
+		case REPL_LRU: {
+			size_t v = 0;
+			for (size_t i = 1; i < s->ways; ++i) {
+				if (s->state[i] > s->state[v]) v = i;
+			}
+			return v;
+		}
+		case REPL_PLRU:
+			if (is_pow2(s->ways)) {
+				size_t node = 1, lo = 0, hi = s->ways;
+				while (hi - lo > 1) {
+					size_t mid = (lo + hi) / 2;
+					if (s->tree[node]) {
+						node = 2 * node + 1;
+						lo = mid;
+					} else {
+						node = 2 * node;
+						hi = mid;
+					}
+				}
+				return lo;
+			}
+			for (size_t i = 0; i < s->ways; ++i) {
+				if (!s->state[i]) return i;
+			}
+			return 0;
+		default:
+			for (;;) {
+				for (size_t i = 0; i < s->ways; ++i) {
+					if (s->state[i] >= 3) return i;
+				}
+				for (size_t i = 0; i < s->ways; ++i) s->state[i]++;
+			}
+	}
+}
+
+// Returns true on a hit
+static bool repl_access(ReplSim *s, size_t line) {
+	for (size_t i = 0; i < s->ways; ++i) {
+		if (s->tag[i] == line + 1) {
+			repl_touch(s, i);
+			return true;
+		}
+	}
+	size_t v = repl_victim(s);
+	if (s->policy == REPL_LRU) s->state[v] = (unsigned)s->ways; // oldest until touched
+	s->tag[v] = line + 1;
+	if (s->policy == REPL_SRRIP) {
+		s->state[v] = 2;
+	} else if (s->policy == REPL_ADAPTIVE) {
+		s->state[v] = (++s->inserts % 32u) == 0 ? 2 : 3;
+	} else {
+		repl_touch(s, v);
+	}
+	return false;
+}
+
+// Steady-state ns per access of a periodic sequence through a stack of same-set caches:
+// level j (policy pol[j], ways[j]) hits cost cost[j], missing all of them costs cost[depth].
+// Inner levels filter what the outer ones see, exactly as on the hardware.
+static double repl_predict(const ReplPolicy *pol, const size_t *ways, const double *cost, size_t depth, const size_t *seq, size_t len) {
+	ReplSim sims[8];
+	for (size_t j = 0; j < depth; ++j) {
+		memset(&sims[j], 0, sizeof(sims[j]));
+		sims[j].policy = pol[j];
+		sims[j].ways = ways[j];
+	}
+	double total = 0.0;
+	for (unsigned r = 0; r < 64; ++r) {
+		for (size_t i = 0; i < len; ++i) {
+			size_t j = 0;
+			while (j < depth && !repl_access(&sims[j], seq[i])) j++;
+			if (r >= 32) total += cost[j];
+		}
+	}
+	return total / (double)(32 * len);
+}
+
+typedef enum ReplSeq {
+	SEQ_HIT = 0,  // W lines cyclic: all hits (reference)
+	SEQ_MISS,     // 4W lines cyclic: (mostly) misses (reference)
+	SEQ_CYCLIC_W1, // W+1 lines cyclic: LRU thrashes, bimodal insertion keeps most
+	SEQ_CYCLIC_2W, // 2W lines cyclic
+	SEQ_HOTSCAN,   // W/2 hot lines touched twice, then a W-line scan: RRIP protects the hot set
+	SEQ_PINNED,    // one hot line between every new line: tree-PLRU evicts it, LRU does not
+	SEQ_COUNT
+} ReplSeq;
+
+static const char *repl_seq_name(ReplSeq q) {
+	switch (q) {
+		case SEQ_HIT: return "hit";
+		case SEQ_MISS: return "miss";
+		case SEQ_CYCLIC_W1: return "cyclic_w+1";
+		case SEQ_CYCLIC_2W: return "cyclic_2w";
+		case SEQ_HOTSCAN: return "hot_scan";
+		case SEQ_PINNED: return "pinned";
+		default: return "?";
+	}
+}
+
+// Line ids of one period of a sequence; lines are numbered 0..(pool-1) within one set.
+// slots bounds how often one line may appear per period (one chase pointer per visit).
+static size_t repl_sequence(ReplSeq q, size_t w, size_t slots, size_t *seq) {
+	size_t n = 0;
+	switch (q) {
+		case SEQ_HIT:
+			for (size_t i = 0; i < w; ++i) seq[n++] = i;
+			break;
+		case SEQ_MISS:
+			for (size_t i = 0; i < 4 * w; ++i) seq[n++] = i;
+			break;
+		case SEQ_CYCLIC_W1:
+			for (size_t i = 0; i <= w; ++i) seq[n++] = i;
+			break;
+		case SEQ_CYCLIC_2W:
+			for (size_t i = 0; i < 2 * w; ++i) seq[n++] = i;
+			break;
+		case SEQ_HOTSCAN: {
+			size_t hot = w / 2 ? w / 2 : 1;
+			for (size_t round = 0; round < 4; ++round) {
+				for (size_t t = 0; t < 2; ++t) {
+					for (size_t i = 0; i < hot; ++i) seq[n++] = i;
+				}
+				for (size_t i = 0; i < w; ++i) seq[n++] = hot + round * w + i;
+			}
+			break;
+		}
+		case SEQ_PINNED: {
+			size_t k = 1; // enough hot lines that each is visited at most slots times
+			while (w / k > slots) k++;
+			for (size_t i = k; i <= w; ++i) {
+				seq[n++] = i % k;
+				seq[n++] = i;
+			}
+			break;
+		}
+		default: break;
+	}
+	return n;
+}
+
+// Lay a sequence out as a chase of 32-bit offsets from base: visit j of a line uses the
+// line's j-th slot, so repeated visits follow different successors. Returns the head offset.
+static uint32_t repl_link(uint8_t *base, size_t set_off, size_t stride, const size_t *seq, size_t len, size_t pool, size_t slots) {
+	unsigned used[8 * REPL_MAX_WAYS];
+	uint32_t *at = (uint32_t *)malloc(len * sizeof(uint32_t));
+	if (!at) return UINT32_MAX;
+	for (size_t i = 0; i < pool; ++i) used[i] = 0;
+	for (size_t j = 0; j < len; ++j) {
+		size_t slot = used[seq[j]]++ % slots;
+		at[j] = (uint32_t)(set_off + seq[j] * stride + slot * sizeof(uint32_t));
+	}
+	for (size_t j = 0; j < len; ++j) {
+		uint32_t next = at[(j + 1) % len];
+		memcpy(base + at[j], &next, sizeof(next));
+	}
+	uint32_t head = at[0];
+	free(at);
+	return head;
+}
+
+static NOINLINE uint32_t chase_offsets(const uint8_t *base, uint32_t off, size_t steps) {
+	for (size_t i = 0; i < steps; ++i) off = *(const volatile uint32_t *)(base + off);
+	return off;
+}
+
+// Best-of-repeats ns per access of an offset chase, run length adapted to target_ms
+static double time_offset_chase(const uint8_t *base, uint32_t head, size_t len, const Options *opt) {
+	uint64_t steps = len * 64ull;
+	uint32_t sink = chase_offsets(base, head, (size_t)steps);
+	uint64_t target_ns = (uint64_t)opt->target_ms * 1000000ull;
+	double best = 1e300;
+	for (unsigned r = 0; r < (opt->repeats ? opt->repeats : 1); ++r) {
+		for (;;) {
+			atomic_signal_fence(memory_order_seq_cst);
+			uint64_t t0 = now_ns();
+			sink ^= chase_offsets(base, head, (size_t)steps);
+			uint64_t t1 = now_ns();
+			atomic_signal_fence(memory_order_seq_cst);
+			if (t1 - t0 >= target_ns / 2 || steps > (1ull << 40)) {
+				double v = (double)(t1 - t0) / (double)steps;
+				if (v < best) best = v;
+				break;
+			}
+			steps *= 2;
+		}
+	}
+	g_sink = (void *)(uintptr_t)sink;
+	return best;
+}
+
+// Nearest simulated policy to the measured miss fractions (sum of squared differences)
+static ReplPolicy repl_classify(const double *measured, const double sim[REPL_COUNT][SEQ_COUNT], double *dist, double *runner_up) {
+	ReplPolicy best = REPL_LRU;
+	double d_best = 1e300, d_second = 1e300;
+	for (int p = 0; p < REPL_COUNT; ++p) {
+		double d = 0.0;
+		for (int q = SEQ_CYCLIC_W1; q < SEQ_COUNT; ++q) d += (measured[q] - sim[p][q]) * (measured[q] - sim[p][q]);
+		if (d < d_best) {
+			d_second = d_best;
+			d_best = d;
+			best = (ReplPolicy)p;
+		} else if (d < d_second) {
+			d_second = d;
+		}
+	}
+	*dist = d_best;
+	*runner_up = d_second;
+	return best;
+}
+
+// For every level with known geometry, chase sequences of lines mapping to one set and turn
+// latencies into miss fractions between the W-line (hit) and 4W-line (miss) references. The
+// same sequences run through simulated LRU, tree-PLRU, SRRIP and bimodal insertion, stacked
+// under the inner levels already identified (their hits hide the outer level), and the nearest
+// candidate wins. Then check thrash resistance with whole-cache cycles just above capacity.
+static int run_replacement_mode(const Options *opt, Workspace *ws, const size_t *sizes, size_t num_sizes) {
+	(void)sizes;
+	(void)num_sizes;
+	CacheGeometry geo[8];
+	size_t nlev = read_sysfs_cache_geometry(opt->cpu >= 0 ? opt->cpu : current_cpu(), geo, 8);
+	if (nlev == 0) {
+		fprintf(stderr, "replacement mode needs cache geometry from sysfs (ways, sets, line size)\n");
+		return 1;
+	}
+	if (opt->json) {
+		printf("{\"type\":\"config\",\"mode\":\"replacement\",\"levels\":%zu,\"target_ms\":%u,\"repeats\":%u}\n", nlev, opt->target_ms, opt->repeats);
+	} else if (opt->print_table) {
+		printf("# Replacement policy probe: miss fraction per same-set sequence (0 = hits at this level, 1 = misses, < 0 = inner-level hits)\n");
+		printf("# level\tways\tsets\tsequence\tns_per_access\tmiss_fraction\tsim_lru\tsim_plru\tsim_srrip\tsim_adaptive\n");
+	}
+	// inner levels identified so far: policy, ways and hit latency (the chain stops at a gap)
+	ReplPolicy inner_pol[8];
+	size_t inner_ways[8];
+	double inner_ns[8];
+	size_t depth = 0;
+	size_t seq[SEQ_COUNT * REPL_MAX_SEQ];
+	for (size_t li = 0; li < nlev; ++li) {
+		const CacheGeometry *g = &geo[li];
+		if (g->ways < 2 || g->ways > REPL_MAX_WAYS || g->sets == 0 || g->line < 4 * sizeof(uint32_t)) {
+			fprintf(stderr, "L%u: geometry unknown or unsupported (ways=%zu sets=%zu line=%zu); skipped\n", g->level, g->ways, g->sets, g->line);
+			depth = 0;
+			continue;
+		}
+		size_t w = g->ways;
+		size_t stride = g->sets * g->line;
+		size_t slots = g->line / sizeof(uint32_t);
+		size_t pool = 4 * w + w / 2 + 1;
+		size_t set_off = (g->sets > 8 ? 5 : 0) * g->line;
+		if (stride * pool > (size_t)UINT32_MAX) {
+			fprintf(stderr, "L%u: %zu same-set lines span more than 4 GiB; skipped\n", g->level, pool);
+			depth = 0;
+			continue;
+		}
+		void *raw = NULL;
+		size_t mapped = 0;
+		uint8_t *base = map_huge(stride * pool, true, &raw, &mapped);
+		if (!base) {
+			fprintf(stderr, "L%u: could not map %zu bytes; skipped\n", g->level, stride * pool);
+			depth = 0;
+			continue;
+		}
+		double ns[SEQ_COUNT];
+		size_t lens[SEQ_COUNT];
+		size_t *seqs[SEQ_COUNT];
+		for (int q = 0; q < SEQ_COUNT; ++q) {
+			seqs[q] = seq + (size_t)q * REPL_MAX_SEQ;
+			lens[q] = repl_sequence((ReplSeq)q, w, slots, seqs[q]);
+			uint32_t head = repl_link(base, set_off, stride, seqs[q], lens[q], pool, slots);
+			ns[q] = head == UINT32_MAX ? 0.0 : time_offset_chase(base, head, lens[q], opt);
+		}
+		munmap(raw, mapped);
+
+		// simulate each candidate under the inner levels, in the same 0..1 units as measured
+		double span = ns[SEQ_MISS] - ns[SEQ_HIT];
+		double miss[SEQ_COUNT], sim[REPL_COUNT][SEQ_COUNT];
+		for (int p = 0; p < REPL_COUNT; ++p) {
+			ReplPolicy pol[9];
+			size_t ways[9];
+			double cost[10];
+			for (size_t j = 0; j < depth; ++j) {
+				pol[j] = inner_pol[j];
+				ways[j] = inner_ways[j];
+				cost[j] = inner_ns[j];
+			}
+			pol[depth] = (ReplPolicy)p;
+			ways[depth] = w;
+			cost[depth] = 0.0;
+			cost[depth + 1] = 1.0;
+			for (size_t j = 0; j < depth; ++j) cost[j] = span > 0.0 ? (inner_ns[j] - ns[SEQ_HIT]) / span : 0.0;
+			for (int q = 0; q < SEQ_COUNT; ++q) sim[p][q] = repl_predict(pol, ways, cost, depth + 1, seqs[q], lens[q]);
+		}
+		for (int q = 0; q < SEQ_COUNT; ++q) {
+			miss[q] = span > 0.0 ? (ns[q] - ns[SEQ_HIT]) / span : 0.0;
+			if (opt->json) {
+				printf("{\"type\":\"replacement_sample\",\"level\":%u,\"ways\":%zu,\"sets\":%zu,\"sequence\":\"%s\",\"ns_per_access\":%.3f,\"miss_fraction\":%.3f,\"sim_lru\":%.3f,\"sim_plru\":%.3f,\"sim_srrip\":%.3f,\"sim_adaptive\":%.3f}\n",
+					g->level, w, g->sets, repl_seq_name((ReplSeq)q), ns[q], miss[q], sim[REPL_LRU][q], sim[REPL_PLRU][q], sim[REPL_SRRIP][q], sim[REPL_ADAPTIVE][q]);
+			} else if (opt->print_table) {
+				printf("L%u\t%zu\t%zu\t%s\t%.3f\t%.3f\t%.2f\t%.2f\t%.2f\t%.2f\n", g->level, w, g->sets, repl_seq_name((ReplSeq)q), ns[q], miss[q],
+					sim[REPL_LRU][q], sim[REPL_PLRU][q], sim[REPL_SRRIP][q], sim[REPL_ADAPTIVE][q]);
+			}
+		}
+
+		// No conflicts at all: the lines did not share a set (hashed/sliced index or physical
+		// set bits beyond the huge page), so there is nothing to classify.
+		char verdict[96];
+		double dist = 0.0, second = 0.0;
+		ReplPolicy found = REPL_LRU;
+		bool conflicts = span > 1.0 && miss[SEQ_CYCLIC_2W] >= 0.3;
+		if (!conflicts) {
+			snprintf(verdict, sizeof(verdict), "undetermined (no same-set conflicts observed)");
+		} else {
+			found = repl_classify(miss, (const double(*)[SEQ_COUNT])sim, &dist, &second);
+			if (second - dist < 0.01 && (found == REPL_LRU || found == REPL_PLRU)) {
+				snprintf(verdict, sizeof(verdict), "LRU or tree-PLRU");
+			} else {
+				snprintf(verdict, sizeof(verdict), "%s", repl_policy_name(found));
+			}
+		}
+		if (conflicts && depth < 8) {
+			inner_pol[depth] = found;
+			inner_ways[depth] = w;
+			inner_ns[depth] = ns[SEQ_HIT];
+			depth++;
+		} else {
+			depth = 0;
+		}
+
+		// thrash resistance: random-order cycle of lines over 1.1x / 1.25x the level vs half and 4x
+		// (random and aligned whatever --pattern / --split say)
+		double thrash[2] = {-1.0, -1.0};
+		size_t cap = g->size_bytes;
+		size_t ls = g->line;
+		Options th = *opt;
+		th.pattern = PATTERN_RANDOM;
+		th.split = SPLIT_NONE;
+		if (cap * 4 <= ws->bytes && cap * 4 / ls <= ws->max_nodes) {
+			double lo = measure_ns_per_access(ws, cap / 2, ls, &th, NULL);
+			double hi = measure_ns_per_access(ws, cap * 4, ls, &th, NULL);
+			const double over[2] = {1.1, 1.25};
+			for (int k = 0; k < 2; ++k) {
+				double v = measure_ns_per_access(ws, (size_t)((double)cap * over[k]), ls, &th, NULL);
+				double f = hi > lo ? (v - lo) / (hi - lo) : 0.0;
+				thrash[k] = f < 0.0 ? 0.0 : (f > 1.0 ? 1.0 : f);
+			}
+		}
+		if (opt->json) {
+			printf("{\"type\":\"replacement\",\"level\":%u,\"ways\":%zu,\"sets\":%zu,\"policy\":\"%s\",\"distance\":%.4f,\"runner_up_distance\":%.4f,\"thrash_miss_1_10\":%.3f,\"thrash_miss_1_25\":%.3f}\n",
+				g->level, w, g->sets, verdict, dist, second, thrash[0], thrash[1]);
+		} else {
+			printf("L%u (%zu-way, %zu sets): %s", g->level, w, g->sets, verdict);
+			if (thrash[0] >= 0.0) {
+				printf("; cyclic working set at 1.1x / 1.25x capacity misses %.0f%% / %.0f%%", thrash[0] * 100.0, thrash[1] * 100.0);
+			}
+			printf("\n");
+		}
+		fflush(stdout);
+	}
+	return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Cache pollution by syscalls, reads, context switches and signals
+// ---------------------------------------------------------------------------
+
+typedef enum Disturbance {
+	DISTURB_NONE = 0,  // warm reference: re-traverse right away
+	DISTURB_FLUSH,     // cold reference: every line of the working set flushed
+	DISTURB_SYSCALL,   // null system call
+	DISTURB_READ,      // read() of --disturb-bytes from a page-cached file
+	DISTURB_CTXSWITCH, // round trip to a process on the same CPU touching its own working set
+	DISTURB_SIGNAL,    // delivery of a signal to an empty handler
+	DISTURB_COUNT
+} Disturbance;
+
+static const char *disturbance_name(Disturbance d) {
+	static const char *names[DISTURB_COUNT] = {"warm", "cold", "syscall", "read", "ctxswitch", "signal"};
+	return d < DISTURB_COUNT ? names[d] : "?";
+}
+
+typedef struct Disturber {
+	int fd;          // page-cached temporary file for DISTURB_READ
+	uint8_t *buf;    // read destination
+	size_t bytes;
+	int to_child;    // token pipes to the context-switch partner
+	int from_child;
+	pid_t child;
+	uint8_t *evict;  // eviction buffer where lines cannot be flushed directly
+	size_t evict_bytes;
+} Disturber;
+
+static volatile sig_atomic_t g_signals;
+
+static void count_signal(int sig) {
+	(void)sig;
+	g_signals++;
+}
+
+// Partner process: for every token, touch one line per 64 bytes of its own working set and
+// answer, so each round trip is two context switches plus the partner's footprint
+static void partner_loop(int in, int out, size_t bytes) {
+	volatile uint8_t *own = (volatile uint8_t *)malloc(bytes ? bytes : 1);
+	char token;
+	while (own && read(in, &token, 1) == 1) {
+		for (size_t i = 0; i < bytes; i += 64) own[i] = (uint8_t)(own[i] + 1u);
+		if (write(out, &token, 1) != 1) break;
+	}
+	_exit(0);
+}
+
+static void disturber_close(Disturber *d) {
+	if (d->child > 0) {
+		close(d->to_child); // EOF ends the partner
+		close(d->from_child);
+		waitpid(d->child, NULL, 0);
+	}
+	if (d->fd >= 0) close(d->fd);
+	free(d->buf);
+	free(d->evict);
+	signal(SIGUSR1, SIG_DFL);
+	memset(d, 0, sizeof(*d));
+	d->fd = -1;
+}
+
+// Set up every disturbance; the caller is pinned so the partner shares its CPU
+static bool disturber_open(Disturber *d, size_t bytes) {
+	memset(d, 0, sizeof(*d));
+	d->fd = -1;
+	d->bytes = bytes;
+	d->buf = (uint8_t *)malloc(bytes ? bytes : 1);
+	if (!d->buf) return false;
+	memset(d->buf, 1, bytes);
+	FILE *f = tmpfile();
+	if (!f) return false;
+	d->fd = dup(fileno(f));
+	bool ok = d->fd >= 0 && fwrite(d->buf, 1, bytes, f) == bytes && fflush(f) == 0;
+	fclose(f);
+	if (!ok) return false;
+#if !defined(HAVE_X86_INTRINSICS) && !(defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__)))
+	d->evict_bytes = 256ull << 20;
+	d->evict = (uint8_t *)malloc(d->evict_bytes);
+	if (!d->evict) return false;
+	memset(d->evict, 1, d->evict_bytes);
+#endif
+	signal(SIGUSR1, count_signal);
+	int down[2], up[2];
+	if (pipe(down) != 0) return false;
+	if (pipe(up) != 0) {
+		close(down[0]);
+		close(down[1]);
+		return false;
+	}
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid < 0) {
+		close(down[0]);
+		close(down[1]);
+		close(up[0]);
+		close(up[1]);
+		return false;
+	}
+	if (pid == 0) {
+		close(down[1]);
+		close(up[0]);
+		partner_loop(down[0], up[1], bytes);
+	}
+	close(down[0]);
+	close(up[1]);
+	d->to_child = down[1];
+	d->from_child = up[0];
+	d->child = pid;
+	return true;
+}
+
+static void disturb(Disturber *d, Disturbance k, void *head, size_t span) {
+	char token = 1;
+	switch (k) {
+		case DISTURB_FLUSH: flush_range(head, span, d->evict, d->evict_bytes); break;
+#if defined(__linux__)
+		case DISTURB_SYSCALL: (void)syscall(SYS_getppid); break; // glibc may cache getpid()
+#else
+		case DISTURB_SYSCALL: (void)getppid(); break;
+#endif
+		case DISTURB_READ:
+			if (pread(d->fd, d->buf, d->bytes, 0) < 0) perror("pread");
+			break;
+		case DISTURB_CTXSWITCH:
+			if (write(d->to_child, &token, 1) != 1 || read(d->from_child, &token, 1) != 1) perror("partner");
+			break;
+		case DISTURB_SIGNAL: raise(SIGUSR1); break;
+		default: break;
+	}
+}
+
+static int cmp_double(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+#define POLLUTION_MAX_TRIALS 4096
+
+// Median ns per access of one pass over the built cycle right after disturbance k, repeated
+// for about target_ms/2 (at least 4 trials). Every trial first brings the set back in.
+static double pass_after_disturbance(Disturber *d, Disturbance k, void *head, size_t nodes, size_t span, const Options *opt, double *trials) {
+	uint64_t budget = (uint64_t)opt->target_ms * 1000000ull / 2;
+	uint64_t start = now_ns();
+	size_t n = 0;
+	do {
+		(void)chase(head, nodes * 2);
+		disturb(d, k, head, span);
+		atomic_signal_fence(memory_order_seq_cst);
+		uint64_t t0 = now_ns();
+		(void)chase(head, nodes);
+		uint64_t t1 = now_ns();
+		atomic_signal_fence(memory_order_seq_cst);
+		trials[n++] = (double)(t1 - t0) / (double)nodes;
+	} while (n < POLLUTION_MAX_TRIALS && (n < 4 || now_ns() - start < budget));
+	g_phase_ns[PHASE_TIMED] += now_ns() - start;
+	qsort(trials, n, sizeof(trials[0]), cmp_double);
+	return n % 2 ? trials[n / 2] : 0.5 * (trials[n / 2 - 1] + trials[n / 2]);
+}
+
+// For every size: warm and flushed reference passes, then one pass after each disturbance.
+// The extra time over the warm pass is the refill cost; scaled by the flushed pass it gives
+// the number of lines that effectively had to come back from memory.
+static int run_pollution_mode(const Options *opt, Workspace *ws, const size_t *sizes, size_t num_sizes) {
+	int cpu = opt->cpu >= 0 ? opt->cpu : current_cpu();
+	if (cpu >= 0 && !pin_to_cpu(cpu)) cpu = -1; // the partner then may not share the CPU
+	Disturber d;
+	double *trials = (double *)malloc(POLLUTION_MAX_TRIALS * sizeof(double));
+	if (!trials || !disturber_open(&d, opt->disturb_bytes)) {
+		fprintf(stderr, "Disturbance setup failed: %s\n", strerror(errno));
+		if (trials) disturber_close(&d);
+		free(trials);
+		return 1;
+	}
+	size_t line = opt->line_size ? opt->line_size : 64;
+	if (opt->json) {
+		printf("{\"type\":\"config\",\"mode\":\"%s\",\"node_stride\":%zu,\"disturb_bytes\":%zu,\"cpu\":%d,\"target_ms\":%u}\n",
+			mode_name(opt->mode), opt->node_stride, opt->disturb_bytes, cpu, opt->target_ms);
+	} else if (opt->print_table) {
+		char buf[32];
+		printf("# Cache pollution per disturbance (node_stride=%zub, read/partner working set %s, cpu %d): median ns/access of one\n",
+			opt->node_stride, human_size(opt->disturb_bytes, buf, sizeof(buf)), cpu);
+		printf("# pass right after it; refill_ns = extra ns per pass over warm, lines = refill as fully missed lines (vs cold)\n");
+		printf("# size_bytes\twarm_ns\tcold_ns");
+		for (int k = DISTURB_SYSCALL; k < DISTURB_COUNT; ++k) {
+			printf("\t%s_ns\t%s_refill_ns\t%s_lines", disturbance_name((Disturbance)k), disturbance_name((Disturbance)k), disturbance_name((Disturbance)k));
+		}
+		printf("\n");
+	}
+	for (size_t i = 0; i < num_sizes; ++i) {
+		size_t nodes = nodes_for_size(sizes[i], opt->node_stride);
+		size_t span = nodes * opt->node_stride;
+		size_t lines = opt->node_stride >= line ? nodes : span / line;
+		build_cycle_pattern(ws->base, nodes, opt->node_stride, ws->perm, &ws->rng, PATTERN_RANDOM, 0, 0);
+		double ns[DISTURB_COUNT];
+		for (int k = 0; k < DISTURB_COUNT; ++k) ns[k] = pass_after_disturbance(&d, (Disturbance)k, ws->base, nodes, span, opt, trials);
+		double miss = ns[DISTURB_FLUSH] - ns[DISTURB_NONE];
+		if (opt->json) {
+			printf("{\"type\":\"pollution\",\"size_bytes\":%zu,\"lines\":%zu,\"warm_ns\":%.3f,\"cold_ns\":%.3f", sizes[i], lines, ns[DISTURB_NONE], ns[DISTURB_FLUSH]);
+		} else if (opt->print_table) {
+			printf("%zu\t%.3f\t%.3f", sizes[i], ns[DISTURB_NONE], ns[DISTURB_FLUSH]);
+		}
+		for (int k = DISTURB_SYSCALL; k < DISTURB_COUNT; ++k) {
+			double extra = ns[k] - ns[DISTURB_NONE];
+			double refill = extra * (double)nodes;
+			double evicted = miss > 0.0 ? extra / miss * (double)lines : 0.0;
+			if (evicted < 0.0) evicted = 0.0;
+			if (evicted > (double)lines) evicted = (double)lines;
+			const char *name = disturbance_name((Disturbance)k);
+			if (opt->json) printf(",\"%s_ns\":%.3f,\"%s_refill_ns\":%.1f,\"%s_lines\":%.1f", name, ns[k], name, refill, name, evicted);
+			else if (opt->print_table) printf("\t%.3f\t%.1f\t%.1f", ns[k], refill, evicted);
+		}
+		if (opt->json) printf("}\n");
+		else if (opt->print_table) printf("\n");
+		fflush(stdout);
+	}
+	disturber_close(&d);
+	free(trials);
+	return 0;
+}
+
+// ---------------------------------------------------------------------------
+// File read throughput: read(), mmap with madvise hints and O_DIRECT
+// ---------------------------------------------------------------------------
+
+typedef enum IoMethod {
+	IO_READ = 0,      // pread() into the buffer
+	IO_MMAP_SEQ,      // mmap + MADV_SEQUENTIAL, copied out in buffer-sized chunks
+	IO_MMAP_WILLNEED, // mmap + MADV_WILLNEED on the whole file
+	IO_MMAP_RANDOM,   // mmap + MADV_RANDOM (no readahead)
+	IO_DIRECT,        // pread() on an O_DIRECT descriptor, bypassing the page cache
+	IO_METHODS
+} IoMethod;
+
+static const char *io_method_name(IoMethod m) {
+	static const char *names[IO_METHODS] = {"read", "mmap_seq", "mmap_willneed", "mmap_random", "direct"};
+	return m < IO_METHODS ? names[m] : "?";
+}
+
+typedef struct IoFile {
+	char path[512];
+	int fd;
+	int direct_fd; // -1 when O_DIRECT is unsupported (e.g. tmpfs)
+	size_t bytes;
+} IoFile;
+
+static void io_close(IoFile *f) {
+	if (f->direct_fd >= 0) close(f->direct_fd);
+	if (f->fd >= 0) close(f->fd);
+	if (f->path[0]) unlink(f->path);
+	f->fd = f->direct_fd = -1;
+	f->path[0] = '\0';
+}
+
+// Create and fill a file of the given size in dir, written through to storage so its page
+// cache can be dropped
+static bool io_create(IoFile *f, const char *dir, size_t bytes, uint8_t *scratch, size_t scratch_bytes) {
+	f->fd = f->direct_fd = -1;
+	f->bytes = bytes;
+	snprintf(f->path, sizeof(f->path), "%s/cache_detect_io.XXXXXX", dir);
+	f->fd = mkstemp(f->path);
+	if (f->fd < 0) {
+		f->path[0] = '\0';
+		return false;
+	}
+	size_t chunk = scratch_bytes < ((size_t)1 << 20) ? scratch_bytes : ((size_t)1 << 20);
+	for (size_t i = 0; i < chunk; i += 64) scratch[i] = (uint8_t)(i >> 6);
+	for (size_t off = 0; off < bytes; ) {
+		size_t n = bytes - off < chunk ? bytes - off : chunk;
+		ssize_t w = write(f->fd, scratch, n);
+		if (w <= 0) return false;
+		off += (size_t)w;
+	}
+	if (fsync(f->fd) != 0) return false;
+#if defined(O_DIRECT)
+	f->direct_fd = open(f->path, O_RDONLY | O_DIRECT);
+#endif
+	return true;
+}
+
+static void io_drop_cache(const IoFile *f) {
+#if defined(POSIX_FADV_DONTNEED)
+	(void)posix_fadvise(f->fd, 0, 0, POSIX_FADV_DONTNEED);
+#else
+	(void)f;
+#endif
+}
+
+// Fraction of the file's pages in the page cache, -1 when unknown
+static double io_resident(const IoFile *f) {
+	void *p = mmap(NULL, f->bytes, PROT_READ, MAP_SHARED, f->fd, 0);
+	if (p == MAP_FAILED) return -1.0;
+	size_t page = page_size();
+	size_t pages = (f->bytes + page - 1) / page;
+	unsigned char *vec = (unsigned char *)malloc(pages);
+	double frac = -1.0;
+	if (vec && mincore(p, f->bytes, (void *)vec) == 0) {
+		size_t in = 0;
+		for (size_t i = 0; i < pages; ++i) in += vec[i] & 1u;
+		frac = (double)in / (double)pages;
+	}
+	free(vec);
+	munmap(p, f->bytes);
+	return frac;
+}
+
+// ns for one pass over the whole file in chunks of b bytes into dst, 0 on error with errno set
+static uint64_t io_pass(const IoFile *f, IoMethod m, uint8_t *dst, size_t b) {
+	uint64_t t0 = now_ns();
+	if (m == IO_READ || m == IO_DIRECT) {
+		int fd = m == IO_DIRECT ? f->direct_fd : f->fd;
+		for (size_t off = 0; off < f->bytes; ) {
+			size_t n = f->bytes - off < b ? f->bytes - off : b;
+			ssize_t r = pread(fd, dst, n, (off_t)off);
+			if (r <= 0) {
+				if (r == 0) errno = EIO; // file shrank under us: pread hit EOF early
+				return 0;
+			}
+			off += (size_t)r;
+		}
+	} else {
+		uint8_t *p = (uint8_t *)mmap(NULL, f->bytes, PROT_READ, MAP_SHARED, f->fd, 0);
+		if (p == MAP_FAILED) return 0;
+		int advice = m == IO_MMAP_SEQ ? MADV_SEQUENTIAL : (m == IO_MMAP_WILLNEED ? MADV_WILLNEED : MADV_RANDOM);
+		(void)madvise(p, f->bytes, advice);
+		for (size_t off = 0; off < f->bytes; off += b) {
+			memcpy(dst, p + off, f->bytes - off < b ? f->bytes - off : b);
+		}
+		munmap(p, f->bytes);
+	}
+	uint64_t t1 = now_ns();
+	g_sink = dst;
+	return t1 > t0 ? t1 - t0 : 1;
+}
+
+// For each method, page-cache state and buffer size: best pass over about target_ms (at least
+// one pass; cold passes drop the file's cache first). Ends with the best buffer per method.
+static int run_io_mode(const Options *opt, Workspace *ws, const size_t *sizes, size_t num_sizes) {
+	size_t file_bytes = (opt->io_bytes + ((size_t)1 << 20) - 1) & ~(((size_t)1 << 20) - 1);
+	if (file_bytes == 0) file_bytes = (size_t)1 << 20;
+	IoFile f;
+	if (!io_create(&f, opt->io_dir, file_bytes, ws->base, ws->bytes)) {
+		fprintf(stderr, "Cannot create a %zu-byte file in %s: %s\n", file_bytes, opt->io_dir, strerror(errno));
+		io_close(&f);
+		return 1;
+	}
+	io_drop_cache(&f);
+	double cold_resident = io_resident(&f);
+	if (opt->json) {
+		printf("{\"type\":\"config\",\"mode\":\"%s\",\"io_dir\":\"%s\",\"file_bytes\":%zu,\"direct\":%s,\"cold_resident\":%.3f,\"target_ms\":%u}\n",
+			mode_name(opt->mode), opt->io_dir, file_bytes, f.direct_fd >= 0 ? "true" : "false", cold_resident, opt->target_ms);
+	} else if (opt->print_table) {
+		char buf[32];
+		printf("# File read throughput (%s file in %s, best pass over ~%ums)\n", human_size(file_bytes, buf, sizeof(buf)), opt->io_dir, opt->target_ms);
+		printf("# after dropping the page cache %.0f%% stays resident%s%s\n", cold_resident * 100.0,
+			cold_resident > 0.5 ? " (cannot be dropped, e.g. tmpfs: cold matches hot)" : "",
+			f.direct_fd >= 0 ? "" : "; O_DIRECT unsupported here");
+		printf("# method\tstate\tsize_bytes\tgbps\tns_per_byte\tus_per_call\n");
+	}
+	uint64_t budget = (uint64_t)opt->target_ms * 1000000ull;
+	size_t warm_chunk = ws->bytes < ((size_t)1 << 20) ? ws->bytes : (size_t)1 << 20; // dst is ws->base
+	for (int m = 0; m < IO_METHODS; ++m) {
+		if (m == IO_DIRECT && f.direct_fd < 0) continue;
+		// O_DIRECT never uses the page cache, so it has a single state
+		for (int cold = 0; cold < (m == IO_DIRECT ? 1 : 2); ++cold) {
+			const char *state = m == IO_DIRECT ? "bypass" : (cold ? "cold" : "hot");
+			size_t best_size = 0;
+			double best_gbps = 0.0;
+			if (!cold && m != IO_DIRECT) (void)io_pass(&f, m, ws->base, warm_chunk); // pull into the cache
+			for (size_t i = 0; i < num_sizes; ++i) {
+				size_t b = sizes[i];
+				if (b > file_bytes) break;
+				if (m == IO_DIRECT && b % 4096 != 0) continue; // O_DIRECT needs block-aligned lengths
+				uint64_t best = 0, spent = 0;
+				do {
+					if (cold) io_drop_cache(&f);
+					uint64_t ns = io_pass(&f, (IoMethod)m, ws->base, b);
+					if (ns == 0) break;
+					spent += ns;
+					if (best == 0 || ns < best) best = ns;
+				} while (spent < budget);
+				g_phase_ns[PHASE_TIMED] += spent;
+				if (best == 0) {
+					fprintf(stderr, "%s with %zu-byte buffers failed: %s\n", io_method_name((IoMethod)m), b, strerror(errno));
+					continue;
+				}
+				double gbps = (double)file_bytes / (double)best;
+				double calls = (double)((file_bytes + b - 1) / b);
+				if (gbps > best_gbps) {
+					best_gbps = gbps;
+					best_size = b;
+				}
+				if (opt->json) {
+					printf("{\"type\":\"io\",\"method\":\"%s\",\"state\":\"%s\",\"size_bytes\":%zu,\"gbps\":%.3f,\"ns_per_byte\":%.4f,\"us_per_call\":%.3f}\n",
+						io_method_name((IoMethod)m), state, b, gbps, 1.0 / gbps, (double)best / calls / 1000.0);
+				} else if (opt->print_table) {
+					printf("%s\t%s\t%zu\t%.3f\t%.4f\t%.3f\n", io_method_name((IoMethod)m), state, b, gbps, 1.0 / gbps, (double)best / calls / 1000.0);
+				}
+				fflush(stdout);
+			}
+			if (best_size == 0) continue;
+			if (opt->json) {
+				printf("{\"type\":\"io_best\",\"method\":\"%s\",\"state\":\"%s\",\"size_bytes\":%zu,\"gbps\":%.3f}\n", io_method_name((IoMethod)m), state, best_size, best_gbps);
+			} else {
+				char buf[32];
+				printf("# best %s (%s): %s buffers, %.3f GB/s\n", io_method_name((IoMethod)m), state, human_size(best_size, buf, sizeof(buf)), best_gbps);
+			}
+		}
+	}
+	io_close(&f);
+	return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Scan resistance: does a streaming scan push a repeatedly used hot set out?
+// ---------------------------------------------------------------------------
+
+// Chase the hot cycle and read per_hop scan lines after every hop until the scan buffer has
+// been read once
+NOINLINE static void *chase_with_scan(void *head, const uint8_t *scan, size_t bytes, size_t line, unsigned per_hop) {
+	void *p = head;
+	uint64_t sum = 0;
+	size_t i = 0;
+	while (i < bytes) {
+		p = *(void * volatile *)p;
+		for (unsigned r = 0; r < per_hop && i < bytes; ++r, i += line) sum += ((const volatile uint8_t *)scan)[i];
+	}
+	g_sink = (void *)(uintptr_t)sum;
+	return p;
+}
+
+typedef struct ScanRunner {
+	const uint8_t *buf;
+	size_t bytes;
+	size_t line;
+	unsigned spin;     // cpu_relax() calls after every line to throttle the scan
+	int cpu;
+	atomic_bool go;
+	atomic_bool done;
+	uint64_t ns;
+} ScanRunner;
+
+// Co-running scan: read every line once, throttled by spin, on a core sharing the L3
+static void *scan_worker(void *arg) {
+	ScanRunner *s = (ScanRunner *)arg;
+	if (s->cpu >= 0) (void)pin_to_cpu(s->cpu);
+	while (!atomic_load_explicit(&s->go, memory_order_acquire)) cpu_relax();
+	uint64_t sum = 0;
+	uint64_t t0 = now_ns();
+	for (size_t i = 0; i < s->bytes; i += s->line) {
+		sum += ((const volatile uint8_t *)s->buf)[i];
+		for (unsigned k = 0; k < s->spin; ++k) cpu_relax();
+	}
+	s->ns = now_ns() - t0;
+	g_sink = (void *)(uintptr_t)sum;
+	atomic_store_explicit(&s->done, true, memory_order_release);
+	return NULL;
+}
+
+static const unsigned scan_lines_per_hop[] = {1, 4, 16};
+static const unsigned scan_spins[] = {0, 8, 64};
+
+// Hot set of --hot-bytes chased while a scan reads each power-of-two size (at least twice the
+// hot set) once: interleaved in this thread at 1, 4 and 16 lines per hop, and on a co-running
+// core sharing the L3 at full speed and throttled. One pass over the hot set afterwards is
+// placed against three references: undisturbed (warm, L2), after reading 2x L2 (L3) and
+// flushed (cold). Between warm and L3 it gives the share still in L2 (the rest in L3), beyond
+// L3 the share demoted to L3 (the rest in memory); without an L2 size only warm..cold is used.
+static int run_scan_mode(const Options *opt, Workspace *ws, const size_t *sizes, size_t num_sizes) {
+	size_t stride = opt->node_stride;
+	size_t line = opt->line_size ? opt->line_size : 64;
+	size_t hot_bytes = opt->hot_bytes;
+	size_t hot_nodes = nodes_for_size(hot_bytes, stride);
+	uint8_t *hot = NULL;
+	size_t *order = (size_t *)malloc(hot_nodes * sizeof(size_t));
+	double *trials = (double *)malloc(64 * sizeof(double));
+	if (!order || !trials || posix_memalign((void **)&hot, 4096, hot_nodes * stride) != 0 || !hot) {
+		fprintf(stderr, "Allocation failed\n");
+		free(order);
+		free(trials);
+		return 1;
+	}
+	memset(hot, 0, hot_nodes * stride);
+	build_cycle_pattern(hot, hot_nodes, stride, order, &ws->rng, PATTERN_RANDOM, 0, 0);
+	unsigned ntrials = opt->repeats < 3 ? 3 : (opt->repeats > 64 ? 64 : opt->repeats);
+
+	// home CPU (--cpu, else the first of --cpus, else where we run now) and a scan CPU: the
+	// second of --cpus, else a distinct core sharing home's L3. Pin before any reference.
+	int cpus[2] = {opt->cpu, -1};
+	if (opt->num_cpus >= 2 && opt->cpu < 0) {
+		cpus[0] = opt->cpus[0];
+		cpus[1] = opt->cpus[1];
+	} else {
+		if (cpus[0] < 0) cpus[0] = opt->num_cpus >= 1 ? opt->cpus[0] : current_cpu();
+		if (opt->num_cpus >= 2) cpus[1] = opt->cpus[0] != cpus[0] ? opt->cpus[0] : opt->cpus[1];
+	}
+	if (cpus[1] < 0 && cpus[0] >= 0) {
+		CpuInfo *topo = (CpuInfo *)calloc(MAX_CPUS, sizeof(CpuInfo));
+		int *list = (int *)calloc(MAX_CPUS, sizeof(int));
+		size_t n = topo && list ? read_topology(topo, MAX_CPUS) : 0;
+		for (size_t i = 0; i < n; ++i) {
+			if (topo[i].cpu != cpus[0]) continue;
+			// placement_cpus() groups around topo[0], so put home there
+			CpuInfo tmp = topo[0];
+			topo[0] = topo[i];
+			topo[i] = tmp;
+			if (placement_cpus(topo, n, PLACEMENT_SAME_L3, list, MAX_CPUS) >= 2) cpus[1] = list[1];
+			break;
+		}
+		free(list);
+		free(topo);
+	}
+	AffinityMask prev;
+	affinity_save(&prev);
+	if (cpus[0] >= 0 && !pin_to_cpu(cpus[0])) {
+		fprintf(stderr, "Could not pin to CPU %d; continuing unpinned.\n", cpus[0]);
+	}
+
+	// references: hot set undisturbed and flushed (the scan buffer doubles as eviction buffer
+	// where lines cannot be flushed directly)
+	double ref[2];
+	for (int cold = 0; cold < 2; ++cold) {
+		for (unsigned t = 0; t < ntrials; ++t) {
+			(void)chase(hot, hot_nodes * 4);
+			if (cold) flush_range(hot, hot_nodes * stride, ws->base, ws->bytes);
+			trials[t] = time_one_pass(hot, hot_nodes);
+		}
+		qsort(trials, ntrials, sizeof(trials[0]), cmp_double);
+		ref[cold] = trials[ntrials / 2];
+	}
+	// L3-resident reference: warm, then push the hot set out of L2 only with an L2-sized thrash
+	size_t cs[8];
+	if (known_cache_sizes(opt, ws, sizes, num_sizes, cs, 8) != 0) cs[1] = 0;
+	size_t thrash_bytes = cs[1] * 2;
+	double l3_ref = -1.0;
+	if (cs[1] > 0 && thrash_bytes <= ws->bytes && (cs[2] == 0 || thrash_bytes < cs[2])) {
+		for (unsigned t = 0; t < ntrials; ++t) {
+			(void)chase(hot, hot_nodes * 4);
+			Streamer th = {ws->base, thrash_bytes, line, 2, -1};
+			(void)stream_worker(&th);
+			trials[t] = time_one_pass(hot, hot_nodes);
+		}
+		qsort(trials, ntrials, sizeof(trials[0]), cmp_double);
+		l3_ref = trials[ntrials / 2];
+		if (l3_ref <= ref[0] || l3_ref >= ref[1]) l3_ref = -1.0; // not between: no usable L3 reference
+	}
+	if (l3_ref < 0.0) fprintf(stderr, "No L3-resident reference (L2 size unknown or thrash ineffective); survival is warm..cold only\n");
+
+	char buf[32];
+	if (opt->json) {
+		printf("{\"type\":\"config\",\"mode\":\"%s\",\"hot_bytes\":%zu,\"node_stride\":%zu,\"warm_ns\":%.3f,\"l3_ns\":%.3f,\"cold_ns\":%.3f,\"cpu\":%d,\"scan_cpu\":%d}\n",
+			mode_name(opt->mode), hot_bytes, stride, ref[0], l3_ref, ref[1], cpus[0], cpus[1]);
+	} else if (opt->print_table) {
+		printf("# Scan resistance: %s hot set (random, warm %.3f ns, L3 %.3f ns, cold %.3f ns per access) vs one scan, CPUs %d,%d\n",
+			human_size(hot_bytes, buf, sizeof(buf)), ref[0], l3_ref, ref[1], cpus[0], cpus[1]);
+		printf("# placement\trate\tscan_bytes\tscan_gbps\thot_ns_after\tl2_pct\tl3_pct\tsurvival_pct\n");
+	}
+	for (int corun = 0; corun < 2; ++corun) {
+		if (corun && cpus[1] < 0) {
+			fprintf(stderr, "No second CPU sharing the L3 (or --cpus A,B); skipping the co-running scan\n");
+			break;
+		}
+		size_t nrates = corun ? sizeof(scan_spins) / sizeof(scan_spins[0]) : sizeof(scan_lines_per_hop) / sizeof(scan_lines_per_hop[0]);
+		for (size_t r = 0; r < nrates; ++r) {
+			char rate[32];
+			if (corun) snprintf(rate, sizeof(rate), scan_spins[r] ? "spin%u" : "full", scan_spins[r]);
+			else snprintf(rate, sizeof(rate), "%u/hop", scan_lines_per_hop[r]);
+			for (size_t i = 0; i < num_sizes; ++i) {
+				size_t s = sizes[i];
+				if (!is_pow2(s) || s < hot_bytes * 2) continue;
+				uint64_t scan_ns = 0;
+				unsigned n = 0;
+				for (unsigned t = 0; t < ntrials; ++t) {
+					(void)chase(hot, hot_nodes * 4);
+					if (!corun) {
+						uint64_t t0 = now_ns();
+						(void)chase_with_scan(hot, ws->base, s, line, scan_lines_per_hop[r]);
+						scan_ns += now_ns() - t0;
+					} else {
+						ScanRunner sr = {ws->base, s, line, scan_spins[r], cpus[1], false, false, 0};
+						pthread_t th;
+						if (pthread_create(&th, NULL, scan_worker, &sr) != 0) {
+							fprintf(stderr, "Thread creation failed\n");
+							break;
+						}
+						(void)chase(hot, hot_nodes);
+						atomic_store_explicit(&sr.go, true, memory_order_release);
+						void *p = hot;
+						while (!atomic_load_explicit(&sr.done, memory_order_acquire)) p = chase(p, 64);
+						pthread_join(th, NULL);
+						scan_ns += sr.ns;
+					}
+					trials[n++] = time_one_pass(hot, hot_nodes);
+				}
+				if (n == 0) continue;
+				qsort(trials, n, sizeof(trials[0]), cmp_double);
+				double after = trials[n / 2];
+				// shares in L2 and L3 (-1 when there is no L3 reference); survival is their sum
+				double l2 = -1.0, l3 = -1.0, survival;
+				if (l3_ref > 0.0) {
+					if (after <= l3_ref) {
+						l2 = (l3_ref - after) / (l3_ref - ref[0]);
+						if (l2 > 1.0) l2 = 1.0;
+						l3 = 1.0 - l2;
+					} else {
+						l2 = 0.0;
+						l3 = (ref[1] - after) / (ref[1] - l3_ref);
+						if (l3 < 0.0) l3 = 0.0;
+					}
+					survival = l2 + l3;
+				} else {
+					survival = ref[1] > ref[0] ? (ref[1] - after) / (ref[1] - ref[0]) : 1.0;
+					if (survival < 0.0) survival = 0.0;
+					if (survival > 1.0) survival = 1.0;
+				}
+				double gbps = scan_ns ? (double)s * n / (double)scan_ns : 0.0;
+				const char *placement = corun ? "corun" : "interleaved";
+				if (opt->json) {
+					printf("{\"type\":\"scan\",\"placement\":\"%s\",\"rate\":\"%s\",\"scan_bytes\":%zu,\"scan_gbps\":%.3f,\"ns_per_access\":%.3f,\"l2_survival\":%.3f,\"l3_survival\":%.3f,\"survival\":%.3f}\n",
+						placement, rate, s, gbps, after, l2, l3, survival);
+				} else if (opt->print_table) {
+					printf("%s\t%s\t%zu\t%.3f\t%.3f\t%.1f\t%.1f\t%.1f\n", placement, rate, s, gbps, after, l2 * 100.0, l3 * 100.0, survival * 100.0);
+				}
+				fflush(stdout);
+			}
+		}
+	}
+	affinity_restore(&prev);
+	free(trials);
+	free(order);
+	free(hot);
+	return 0;
+}
+
+// ---------------------------------------------------------------------------
+// AMAC: G interleaved pointer-chain lookups as hand-rolled coroutines with prefetch
+// ---------------------------------------------------------------------------
+
+#define AMAC_MAX_GROUP 64
+
+static const unsigned amac_groups[] = {1, 2, 4, 8, 16, 32};
+static const unsigned amac_depths[] = {1, 2, 4, 8};
+
+static inline void prefetch_line(const void *p) {
+#if defined(__GNUC__) || defined(__clang__)
+	__builtin_prefetch(p, 0, 3);
+#else
+	(void)p;
+#endif
+}
+
+// Node where lookup key starts: a multiplicative hash spread over the cycle's nodes
+static inline void *amac_start(uint8_t *base, size_t nodes, size_t stride, uint64_t key) {
+	uint64_t h = (key + 1) * 0x9e3779b97f4a7c15ULL;
+	return base + (size_t)(((h >> 32) * (uint64_t)nodes) >> 32) * stride;
+}
+
+// One coroutine per slot: each resume follows one pointer of its chain, then prefetches the
+// next node and yields to the next slot, so G misses are in flight. A chain ends after depth
+// hops and the slot starts the next lookup.
+typedef struct AmacSlot {
+	void *p;
+	unsigned left;
+} AmacSlot;
+
+NOINLINE static uint64_t amac_lookups(uint8_t *base, size_t nodes, size_t stride, unsigned g, unsigned depth, uint64_t lookups, bool prefetch) {
+	AmacSlot s[AMAC_MAX_GROUP];
+	uint64_t key = 0, done = 0, acc = 0;
+	for (unsigned i = 0; i < g; ++i) {
+		s[i].p = amac_start(base, nodes, stride, key++);
+		s[i].left = depth;
+		if (prefetch) prefetch_line(s[i].p);
+	}
+	unsigned i = 0;
+	while (done < lookups) {
+		AmacSlot *c = &s[i];
+		void *next = *(void * volatile *)c->p;
+		if (--c->left == 0) {
+			acc += (uintptr_t)next;
+			done++;
+			next = amac_start(base, nodes, stride, key++);
+			c->left = depth;
+		}
+		c->p = next;
+		if (prefetch) prefetch_line(next);
+		if (++i == g) i = 0;
+	}
+	g_sink = (void *)(uintptr_t)acc;
+	return acc;
+}
+
+// ns per lookup: lookup count doubled until a run takes target_ms/8, best of opt->repeats
+// runs of about target_ms/4
+static double time_amac(uint8_t *base, size_t nodes, size_t stride, unsigned g, unsigned depth, bool prefetch, const Options *opt) {
+	uint64_t target = (uint64_t)opt->target_ms * 1000000ull / 4;
+	uint64_t lookups = 1024;
+	uint64_t t0 = now_ns();
+	(void)amac_lookups(base, nodes, stride, g, depth, lookups, prefetch);
+	for (;;) {
+		uint64_t c0 = now_ns();
+		(void)amac_lookups(base, nodes, stride, g, depth, lookups, prefetch);
+		if (now_ns() - c0 >= target / 2 || lookups > (1ull << 40)) break;
+		lookups *= 2;
+	}
+	phase_add(PHASE_CALIBRATE, t0);
+	double best = 1e300;
+	for (unsigned r = 0; r < (opt->repeats ? opt->repeats : 1); ++r) {
+		atomic_signal_fence(memory_order_seq_cst);
+		uint64_t a = now_ns();
+		(void)amac_lookups(base, nodes, stride, g, depth, lookups, prefetch);
+		uint64_t b = now_ns();
+		atomic_signal_fence(memory_order_seq_cst);
+		g_phase_ns[PHASE_TIMED] += b - a;
+		double ns = (double)(b - a) / (double)lookups;
+		if (ns < best) best = ns;
+	}
+	return best;
+}
+
+// For every power-of-two size and chain depth D: ns per lookup at each group size G with a
+// prefetch at every yield, the best G, its speedup over one lookup at a time, and the same
+// G without prefetch (what out-of-order execution alone overlaps).
+static int run_amac_mode(const Options *opt, Workspace *ws, const size_t *sizes, size_t num_sizes) {
+	const size_t ng = sizeof(amac_groups) / sizeof(amac_groups[0]);
+	const size_t nd = sizeof(amac_depths) / sizeof(amac_depths[0]);
+	if (opt->json) {
+		printf("{\"type\":\"config\",\"mode\":\"%s\",\"node_stride\":%zu,\"pattern\":\"%s\",\"target_ms\":%u,\"repeats\":%u}\n",
+			mode_name(opt->mode), opt->node_stride, pattern_name(opt->pattern), opt->target_ms, opt->repeats);
+	} else if (opt->print_table) {
+		printf("# AMAC interleaved lookups, ns per lookup of depth D with G in flight (node_stride=%zub, pattern=%s)\n",
+			opt->node_stride, pattern_name(opt->pattern));
+		printf("# size_bytes\tdepth");
+		for (size_t k = 0; k < ng; ++k) printf("\tg%u_ns", amac_groups[k]);
+		printf("\tbest_g\tspeedup\tbest_g_noprefetch_ns\n");
+	}
+	for (size_t i = 0; i < num_sizes; ++i) {
+		size_t wsb = sizes[i];
+		if (!is_pow2(wsb)) continue;
+		size_t nodes = nodes_for_size(wsb, opt->node_stride);
+		build_cycle_pattern(ws->base, nodes, opt->node_stride, ws->perm, &ws->rng, opt->pattern, opt->pattern_arg, 0);
+		for (size_t d = 0; d < nd; ++d) {
+			double ns[sizeof(amac_groups) / sizeof(amac_groups[0])];
+			size_t best = 0;
+			for (size_t k = 0; k < ng; ++k) {
+				ns[k] = time_amac(ws->base, nodes, opt->node_stride, amac_groups[k], amac_depths[d], true, opt);
+				if (ns[k] < ns[best]) best = k;
+			}
+			double nopf = time_amac(ws->base, nodes, opt->node_stride, amac_groups[best], amac_depths[d], false, opt);
+			double speedup = ns[best] > 0.0 ? ns[0] / ns[best] : 0.0;
+			if (opt->json) {
+				printf("{\"type\":\"amac\",\"size_bytes\":%zu,\"depth\":%u", wsb, amac_depths[d]);
+				for (size_t k = 0; k < ng; ++k) printf(",\"g%u_ns\":%.3f", amac_groups[k], ns[k]);
+				printf(",\"best_g\":%u,\"speedup\":%.2f,\"best_g_noprefetch_ns\":%.3f}\n", amac_groups[best], speedup, nopf);
+			} else if (opt->print_table) {
+				printf("%zu\t%u", wsb, amac_depths[d]);
+				for (size_t k = 0; k < ng; ++k) printf("\t%.3f", ns[k]);
+				printf("\t%u\t%.2f\t%.3f\n", amac_groups[best], speedup, nopf);
+			}
+			fflush(stdout);
+		}
+	}
+	return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Multi-chain chase over 32-bit node indices: scalar loops vs hardware gathers
+// ---------------------------------------------------------------------------
+
+// Link nodes in order; each node's first word holds the word index of the next node.
+static void build_index_cycle_from_order(uint32_t *words, size_t num_nodes, size_t node_words, const size_t *order) {
+	for (size_t i = 0; i < num_nodes; ++i) {
+		size_t from = order[i];
+		size_t to = order[(i + 1) % num_nodes];
+		words[from * node_words] = (uint32_t)(to * node_words);
+	}
+}
+
+// Advance `lanes` independent chains by `steps` hops each; idx holds the chain heads
+typedef void (*GatherFn)(const uint32_t *words, uint32_t *idx, size_t steps);
+
+NOINLINE static void gather_scalar8(const uint32_t *words, uint32_t *idx, size_t steps) {
+	const volatile uint32_t *w = words;
+	uint32_t a0 = idx[0], a1 = idx[1], a2 = idx[2], a3 = idx[3];
+	uint32_t a4 = idx[4], a5 = idx[5], a6 = idx[6], a7 = idx[7];
+	for (size_t i = 0; i < steps; ++i) {
+		a0 = w[a0]; a1 = w[a1]; a2 = w[a2]; a3 = w[a3];
+		a4 = w[a4]; a5 = w[a5]; a6 = w[a6]; a7 = w[a7];
+	}
+	idx[0] = a0; idx[1] = a1; idx[2] = a2; idx[3] = a3;
+	idx[4] = a4; idx[5] = a5; idx[6] = a6; idx[7] = a7;
+}
+
+NOINLINE static void gather_scalar16(const uint32_t *words, uint32_t *idx, size_t steps) {
+	const volatile uint32_t *w = words;
+	uint32_t a[16];
+	for (unsigned l = 0; l < 16; ++l) a[l] = idx[l];
+	for (size_t i = 0; i < steps; ++i) {
+		a[0] = w[a[0]]; a[1] = w[a[1]]; a[2] = w[a[2]]; a[3] = w[a[3]];
+		a[4] = w[a[4]]; a[5] = w[a[5]]; a[6] = w[a[6]]; a[7] = w[a[7]];
+		a[8] = w[a[8]]; a[9] = w[a[9]]; a[10] = w[a[10]]; a[11] = w[a[11]];
+		a[12] = w[a[12]]; a[13] = w[a[13]]; a[14] = w[a[14]]; a[15] = w[a[15]];
+	}
+	for (unsigned l = 0; l < 16; ++l) idx[l] = a[l];
+}
+
+#if defined(HAVE_X86_INTRINSICS)
+__attribute__((target("avx2"))) NOINLINE static void gather_avx2_8(const uint32_t *words, uint32_t *idx, size_t steps) {
+	__m256i v = _mm256_loadu_si256((const __m256i *)(const void *)idx);
+	for (size_t i = 0; i < steps; ++i) {
+		v = _mm256_i32gather_epi32((const int *)(const void *)words, v, 4);
+	}
+	_mm256_storeu_si256((__m256i *)(void *)idx, v);
+}
+
+__attribute__((target("avx2"))) NOINLINE static void gather_avx2_16(const uint32_t *words, uint32_t *idx, size_t steps) {
+	__m256i v0 = _mm256_loadu_si256((const __m256i *)(const void *)idx);
+	__m256i v1 = _mm256_loadu_si256((const __m256i *)(const void *)(idx + 8));
+	for (size_t i = 0; i < steps; ++i) {
+		v0 = _mm256_i32gather_epi32((const int *)(const void *)words, v0, 4);
+		v1 = _mm256_i32gather_epi32((const int *)(const void *)words, v1, 4);
+	}
+	_mm256_storeu_si256((__m256i *)(void *)idx, v0);
+	_mm256_storeu_si256((__m256i *)(void *)(idx + 8), v1);
+}
+
+__attribute__((target("avx512f"))) NOINLINE static void gather_avx512_16(const uint32_t *words, uint32_t *idx, size_t steps) {
+	__m512i v = _mm512_loadu_si512((const void *)idx);
+	for (size_t i = 0; i < steps; ++i) {
+		v = _mm512_i32gather_epi32(v, (const void *)words, 4);
+	}
+	_mm512_storeu_si512((void *)idx, v);
+}
+#endif
+
+#if defined(__ARM_FEATURE_SVE)
+// One SVE vector of chains (vector length / 32 lanes, 4..64)
+NOINLINE static void gather_sve(const uint32_t *words, uint32_t *idx, size_t steps) {
+	svbool_t pg = svptrue_b32();
+	svuint32_t v = svld1_u32(pg, idx);
+	for (size_t i = 0; i < steps; ++i) {
+		v = svld1_gather_u32index_u32(pg, words, v);
+	}
+	svst1_u32(pg, idx, v);
+}
+#endif
+
+typedef struct GatherKernel {
+	const char *name;
+	size_t lanes;
+	GatherFn fn;
+} GatherKernel;
+
+// Kernels usable on this CPU (runtime-checked for x86 ISA extensions)
+static size_t gather_kernels(GatherKernel *out) {
+	size_t n = 0;
+	out[n++] = (GatherKernel){"scalar8", 8, gather_scalar8};
+	out[n++] = (GatherKernel){"scalar16", 16, gather_scalar16};
+#if defined(HAVE_X86_INTRINSICS)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		out[n++] = (GatherKernel){"avx2_gather8", 8, gather_avx2_8};
+		out[n++] = (GatherKernel){"avx2_gather16", 16, gather_avx2_16};
+	}
+	if (__builtin_cpu_supports("avx512f")) {
+		out[n++] = (GatherKernel){"avx512_gather16", 16, gather_avx512_16};
+	}
+#endif
+#if defined(__ARM_FEATURE_SVE)
+	out[n++] = (GatherKernel){"sve_gather", svcntw(), gather_sve};
+#endif
+	return n;
+}
+
+// ns per individual node visit (steps * lanes), best of opt->repeats
+static double time_gather(const GatherKernel *k, const uint32_t *words, const uint32_t *heads, size_t nodes, const Options *opt) {
+	uint32_t idx[64];
+	memcpy(idx, heads, k->lanes * sizeof(uint32_t));
+	size_t pass = nodes / k->lanes + 1;
+	for (unsigned w = 0; w < opt->warmup_iters; ++w) k->fn(words, idx, pass);
+	uint64_t target_ns = (uint64_t)opt->target_ms * 1000000ull;
+	uint64_t steps = pass * 4ull;
+	if (steps < 1000ull) steps = 1000ull;
+	double best = 1e300;
+	for (unsigned r = 0; r < opt->repeats; ++r) {
+		uint64_t dt;
+		for (;;) {
+			atomic_signal_fence(memory_order_seq_cst);
+			uint64_t t0 = now_ns();
+			k->fn(words, idx, (size_t)steps);
+			uint64_t t1 = now_ns();
+			atomic_signal_fence(memory_order_seq_cst);
+			dt = t1 - t0;
+			if (dt >= target_ns / 2 || steps > (1ull << 62)) break;
+			steps *= 2;
+		}
+		atomic_signal_fence(memory_order_seq_cst);
+		uint64_t t0 = now_ns();
+		k->fn(words, idx, (size_t)steps);
+		uint64_t t1 = now_ns();
+		atomic_signal_fence(memory_order_seq_cst);
+		dt = t1 - t0;
+		double ns = (double)dt / ((double)steps * (double)k->lanes);
+		if (ns < best) best = ns;
+	}
+	g_sink = (void *)(uintptr_t)idx[0];
+	return best;
+}
+
+// For each size, chase 8/16 independent chains with scalar loads and with gathers.
+// Reported ns are per node visit, so lower means more memory-level parallelism extracted.
+static int run_gather_mode(const Options *opt, Workspace *ws, const size_t *sizes, size_t num_sizes) {
+	if (opt->node_stride % sizeof(uint32_t) != 0) {
+		fprintf(stderr, "gather mode needs --node-stride to be a multiple of 4\n");
+		return 1;
+	}
+	GatherKernel kernels[8];
+	size_t nk = gather_kernels(kernels);
+	size_t node_words = opt->node_stride / sizeof(uint32_t);
+	uint32_t *words = (uint32_t *)(void *)ws->base;
+	if (opt->json) {
+		printf("{\"type\":\"config\",\"mode\":\"%s\",\"node_stride\":%zu,\"pattern\":\"%s\"}\n", mode_name(opt->mode), opt->node_stride, pattern_name(opt->pattern));
+	} else if (opt->print_table) {
+		printf("# Multi-chain chase over 32-bit indices, ns per node visit (node_stride=%zub, pattern=%s)\n", opt->node_stride, pattern_name(opt->pattern));
+		printf("# size_bytes");
+		for (size_t k = 0; k < nk; ++k) printf("\t%s_ns", kernels[k].name);
+		printf("\n");
+	}
+	for (size_t i = 0; i < num_sizes; ++i) {
+		size_t wsb = sizes[i];
+		size_t nodes = nodes_for_size(wsb, opt->node_stride);
+		if (nodes * node_words > (size_t)INT32_MAX) break; // gathers take signed 32-bit indices
+		build_order_pattern(ws->perm, nodes, &ws->rng, opt->pattern, opt->pattern_arg);
+		build_index_cycle_from_order(words, nodes, node_words, ws->perm);
+		if (opt->json) {
+			printf("{\"type\":\"gather\",\"size_bytes\":%zu", wsb);
+		} else if (opt->print_table) {
+			printf("%zu", wsb);
+		}
+		for (size_t k = 0; k < nk; ++k) {
+			// chain heads spread evenly along the cycle so chains do not overlap
+			uint32_t heads[64];
+			for (size_t l = 0; l < kernels[k].lanes; ++l) {
+				heads[l] = (uint32_t)(ws->perm[(l * nodes) / kernels[k].lanes] * node_words);
+			}
+			double ns = time_gather(&kernels[k], words, heads, nodes, opt);
+			if (opt->json) {
+				printf(",\"%s_ns\":%.3f", kernels[k].name, ns);
+			} else if (opt->print_table) {
+				printf("\t%.3f", ns);
+			}
+		}
+		if (opt->json || opt->print_table) printf(opt->json ? "}\n" : "\n");
+		fflush(stdout);
+	}
+	return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Lock handoff suite: test-and-set, ticket, MCS, futex and pthread mutexes
+// ---------------------------------------------------------------------------
+
+typedef enum LockKind {
+	LOCK_TAS = 0,
+	LOCK_TICKET,
+	LOCK_MCS,
+	LOCK_FUTEX,
+	LOCK_PTHREAD,
+	LOCK_COUNT
+} LockKind;
+
+static const char *lock_name(LockKind k) {
+	switch (k) {
+		case LOCK_TAS: return "tas";
+		case LOCK_TICKET: return "ticket";
+		case LOCK_MCS: return "mcs";
+		case LOCK_FUTEX: return "futex";
+		case LOCK_PTHREAD: return "pthread";
+		default: return "?";
+	}
+}
+
+typedef struct McsNode {
+	_Atomic(struct McsNode *) next;
+	atomic_int locked;
+} McsNode;
+
+// Every independently written word gets its own 128-byte block (adjacent-line prefetch)
+typedef struct LockBench {
+	_Alignas(128) atomic_uint tas;
+	_Alignas(128) atomic_uint ticket_next;
+	_Alignas(128) atomic_uint ticket_serving;
+	_Alignas(128) _Atomic(McsNode *) mcs_tail;
+	_Alignas(128) atomic_uint futex_word;
+	_Alignas(128) pthread_mutex_t mutex;
+	_Alignas(128) uint64_t counter; // protected by the lock under test
+	int last_owner;
+	uint64_t handoffs;
+	bool timed;          // stamp releases and sum release-to-acquire gaps across threads
+	uint64_t release_ns; // last release time (timed runs)
+	uint64_t handoff_ns; // sum of release -> next acquire by another thread (timed runs)
+	_Alignas(128) atomic_uint ready;
+	atomic_bool go;
+	atomic_bool stop;
+	LockKind kind;
+} LockBench;
+
+typedef struct LockThread {
+	_Alignas(128) McsNode node;
+	LockBench *bench;
+	pthread_t thread;
+	int cpu;
+	int id;
+	uint64_t ops;
+} LockThread;
+
+#if defined(__linux__)
+static void futex_wait(atomic_uint *w, unsigned val) {
+	syscall(SYS_futex, (unsigned *)w, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void futex_wake_one(atomic_uint *w) {
+	syscall(SYS_futex, (unsigned *)w, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+#endif
+
+static void lock_acquire(LockBench *b, McsNode *me) {
+	switch (b->kind) {
+		case LOCK_TAS:
+			for (;;) {
+				if (atomic_exchange_explicit(&b->tas, 1u, memory_order_acquire) == 0u) return;
+				while (atomic_load_explicit(&b->tas, memory_order_relaxed) != 0u) cpu_relax();
+			}
+		case LOCK_TICKET: {
+			unsigned t = atomic_fetch_add_explicit(&b->ticket_next, 1u, memory_order_relaxed);
+			while (atomic_load_explicit(&b->ticket_serving, memory_order_acquire) != t) cpu_relax();
+			return;
+		}
+		case LOCK_MCS: {
+			atomic_store_explicit(&me->next, NULL, memory_order_relaxed);
+			atomic_store_explicit(&me->locked, 1, memory_order_relaxed);
+			McsNode *prev = atomic_exchange_explicit(&b->mcs_tail, me, memory_order_acq_rel);
+			if (prev) {
+				atomic_store_explicit(&prev->next, me, memory_order_release);
+				while (atomic_load_explicit(&me->locked, memory_order_acquire) != 0) cpu_relax();
+			}
+			return;
+		}
+		case LOCK_FUTEX: {
+#if defined(__linux__)
+			// Drepper's "Futexes Are Tricky" mutex: 0 free, 1 locked, 2 locked with waiters
+			unsigned c = 0;
+			if (atomic_compare_exchange_strong_explicit(&b->futex_word, &c, 1u, memory_order_acquire, memory_order_relaxed)) return;
+			if (c != 2u) c = atomic_exchange_explicit(&b->futex_word, 2u, memory_order_acquire);
+			while (c != 0u) {
+				futex_wait(&b->futex_word, 2u);
+				c = atomic_exchange_explicit(&b->futex_word, 2u, memory_order_acquire);
+			}
+			return;
+#else
+			pthread_mutex_lock(&b->mutex);
+			return;
+#endif
+		}
+		case LOCK_PTHREAD:
+		default:
+			pthread_mutex_lock(&b->mutex);
+			return;
+	}
+}
+
+static void lock_release(LockBench *b, McsNode *me) {
+	switch (b->kind) {
+		case LOCK_TAS:
+			atomic_store_explicit(&b->tas, 0u, memory_order_release);
+			return;
+		case LOCK_TICKET:
+			atomic_store_explicit(&b->ticket_serving, atomic_load_explicit(&b->ticket_serving, memory_order_relaxed) + 1u, memory_order_release);
+			return;
+		case LOCK_MCS: {
+			McsNode *next = atomic_load_explicit(&me->next, memory_order_acquire);
+			if (!next) {
+				McsNode *expected = me;
+				if (atomic_compare_exchange_strong_explicit(&b->mcs_tail, &expected, NULL, memory_order_acq_rel, memory_order_relaxed)) return;
+				while ((next = atomic_load_explicit(&me->next, memory_order_acquire)) == NULL) cpu_relax();
+			}
+			atomic_store_explicit(&next->locked, 0, memory_order_release);
+			return;
+		}
+		case LOCK_FUTEX:
+#if defined(__linux__)
+			if (atomic_fetch_sub_explicit(&b->futex_word, 1u, memory_order_release) != 1u) {
+				atomic_store_explicit(&b->futex_word, 0u, memory_order_release);
+				futex_wake_one(&b->futex_word);
+			}
+			return;
+#else
+			pthread_mutex_unlock(&b->mutex);
+			return;
+#endif
+		case LOCK_PTHREAD:
+		default:
+			pthread_mutex_unlock(&b->mutex);
+			return;
+	}
+}
+
+static void *lock_worker(void *arg) {
+	LockThread *t = (LockThread *)arg;
+	LockBench *b = t->bench;
+	if (t->cpu >= 0) (void)pin_to_cpu(t->cpu);
+	atomic_fetch_add_explicit(&b->ready, 1u, memory_order_acq_rel);
+	while (!atomic_load_explicit(&b->go, memory_order_acquire)) cpu_relax();
+	uint64_t ops = 0;
+	while (!atomic_load_explicit(&b->stop, memory_order_relaxed)) {
+		lock_acquire(b, &t->node);
+		b->counter++;
+		if (b->last_owner != t->id) {
+			if (b->timed && b->last_owner >= 0) b->handoff_ns += now_ns() - b->release_ns;
+			b->last_owner = t->id;
+			b->handoffs++;
+		}
+		if (b->timed) b->release_ns = now_ns();
+		lock_release(b, &t->node);
+		ops++;
+	}
+	t->ops = ops;
+	return NULL;
+}
+
+typedef struct LockResult {
+	uint64_t ops;
+	uint64_t handoffs;
+	uint64_t elapsed_ns;
+	double fairness;   // min/max per-thread acquisitions
+	double handoff_ns; // mean release -> acquire by another thread (timed runs, else 0)
+} LockResult;
+
+// Run nthreads contending on one lock for duration_ms; returns false if threads could not start.
+// A timed run reads the clock at every release and handoff, so its throughput is not reported.
+static bool run_lock_bench(LockKind kind, const int *cpus, size_t nthreads, unsigned duration_ms, bool timed, LockResult *res) {
+	LockBench *b = NULL;
+	if (posix_memalign((void **)&b, 128, sizeof(LockBench)) != 0 || !b) return false;
+	memset(b, 0, sizeof(*b));
+	LockThread *threads = NULL;
+	if (posix_memalign((void **)&threads, 128, nthreads * sizeof(LockThread)) != 0 || !threads) {
+		free(b);
+		return false;
+	}
+	memset(threads, 0, nthreads * sizeof(LockThread));
+	pthread_mutex_init(&b->mutex, NULL);
+	b->kind = kind;
+	b->last_owner = -1;
+	b->timed = timed;
+	size_t started = 0;
+	for (size_t i = 0; i < nthreads; ++i) {
+		threads[i].bench = b;
+		threads[i].cpu = cpus[i];
+		threads[i].id = (int)i;
+		if (pthread_create(&threads[i].thread, NULL, lock_worker, &threads[i]) != 0) break;
+		started++;
+	}
+	while (atomic_load_explicit(&b->ready, memory_order_acquire) < (unsigned)started) cpu_relax();
+	uint64_t t0 = now_ns();
+	atomic_store_explicit(&b->go, true, memory_order_release);
+	sleep_ms(duration_ms);
+	atomic_store_explicit(&b->stop, true, memory_order_release);
+	for (size_t i = 0; i < started; ++i) pthread_join(threads[i].thread, NULL);
+	uint64_t t1 = now_ns();
+	uint64_t min_ops = UINT64_MAX, max_ops = 0, total = 0;
+	for (size_t i = 0; i < started; ++i) {
+		total += threads[i].ops;
+		if (threads[i].ops < min_ops) min_ops = threads[i].ops;
+		if (threads[i].ops > max_ops) max_ops = threads[i].ops;
+	}
+	res->ops = total;
+	res->handoffs = b->handoffs;
+	res->elapsed_ns = t1 - t0;
+	res->fairness = max_ops > 0 ? (double)min_ops / (double)max_ops : 0.0;
+	res->handoff_ns = timed && b->handoffs > 1 ? (double)b->handoff_ns / (double)(b->handoffs - 1) : 0.0;
+	pthread_mutex_destroy(&b->mutex);
+	free(threads);
+	free(b);
+	return started == nthreads;
+}
+
+static void run_lock_placement(const Options *opt, const char *label, const int *cpus, size_t ncpus) {
+	if (ncpus < 2) {
+		if (!opt->json) printf("# %s: fewer than 2 CPUs available, skipped\n", label);
+		return;
+	}
+	char cpu_str[256];
+	// thread counts: powers of two, then all CPUs of the placement
+	for (size_t nthreads = 2; nthreads <= ncpus && nthreads <= opt->max_threads;) {
+		size_t off = 0;
+		cpu_str[0] = '\0';
+		for (size_t i = 0; i < nthreads && off + 12 < sizeof(cpu_str); ++i) {
+			off += (size_t)snprintf(cpu_str + off, sizeof(cpu_str) - off, i ? ",%d" : "%d", cpus[i]);
+		}
+		for (int k = 0; k < LOCK_COUNT; ++k) {
+			LockResult best = {0};
+			double best_mops = -1.0;
+			for (unsigned r = 0; r < opt->repeats; ++r) {
+				LockResult res;
+				if (!run_lock_bench((LockKind)k, cpus, nthreads, opt->target_ms, false, &res)) {
+					fprintf(stderr, "Could not start %zu threads for %s lock\n", nthreads, lock_name((LockKind)k));
+					break;
+				}
+				double mops = (double)res.ops * 1e3 / (double)res.elapsed_ns;
+				if (mops > best_mops) {
+					best_mops = mops;
+					best = res;
+				}
+			}
+			if (best_mops < 0.0) continue;
+			double ns_per_acquire = best.ops ? (double)best.elapsed_ns / (double)best.ops : 0.0;
+			// handoff latency from one extra run that timestamps each release and handoff
+			LockResult timed;
+			double ns_per_handoff = run_lock_bench((LockKind)k, cpus, nthreads, opt->target_ms, true, &timed) ? timed.handoff_ns : 0.0;
+			if (opt->json) {
+				printf("{\"type\":\"lock\",\"placement\":\"%s\",\"lock\":\"%s\",\"threads\":%zu,\"cpus\":\"%s\",\"mops_per_s\":%.3f,\"ns_per_acquire\":%.2f,\"ns_per_handoff\":%.2f,\"handoff_fraction\":%.4f,\"fairness\":%.3f}\n",
+					label, lock_name((LockKind)k), nthreads, cpu_str, best_mops, ns_per_acquire, ns_per_handoff,
+					best.ops ? (double)best.handoffs / (double)best.ops : 0.0, best.fairness);
+			} else if (opt->print_table) {
+				printf("%s\t%s\t%zu\t%s\t%.3f\t%.2f\t%.2f\t%.4f\t%.3f\n", label, lock_name((LockKind)k), nthreads, cpu_str, best_mops,
+					ns_per_acquire, ns_per_handoff, best.ops ? (double)best.handoffs / (double)best.ops : 0.0, best.fairness);
+			}
+			fflush(stdout);
+		}
+		if (nthreads == ncpus) break;
+		nthreads = nthreads * 2 > ncpus ? ncpus : nthreads * 2;
+	}
+}
+
+// Sweep lock kinds and thread counts for each topology placement (or the --cpus list)
+static int run_locks_mode(const Options *opt) {
+	if (opt->json) {
+		printf("{\"type\":\"config\",\"mode\":\"%s\",\"duration_ms\":%u,\"repeats\":%u}\n", mode_name(opt->mode), opt->target_ms, opt->repeats);
+	} else if (opt->print_table) {
+		printf("# Lock handoff latency and throughput (duration=%ums, best of %u)\n", opt->target_ms, opt->repeats);
+		printf("# placement\tlock\tthreads\tcpus\tmops_per_s\tns_per_acquire\tns_per_handoff\thandoff_fraction\tfairness\n");
+	}
+	if (opt->num_cpus > 0) {
+		run_lock_placement(opt, "custom", opt->cpus, opt->num_cpus);
+		return 0;
+	}
+	CpuInfo *topo = (CpuInfo *)calloc(MAX_CPUS, sizeof(CpuInfo));
+	int *cpus = (int *)calloc(MAX_CPUS, sizeof(int));
+	if (!topo || !cpus) {
+		fprintf(stderr, "Topology allocation failed\n");
+		free(topo);
+		free(cpus);
+		return 1;
+	}
+	size_t n = read_topology(topo, MAX_CPUS);
+	for (int p = 0; p < PLACEMENT_COUNT; ++p) {
+		size_t ncpus = placement_cpus(topo, n, (Placement)p, cpus, MAX_CPUS);
+		run_lock_placement(opt, placement_name((Placement)p), cpus, ncpus);
+	}
+	free(cpus);
+	free(topo);
+	return 0;
+}
+
+// ---------------------------------------------------------------------------
+// False sharing: two pinned threads bump private counters at a given separation
+// ---------------------------------------------------------------------------
+
+typedef struct ShareBench {
+	_Alignas(128) atomic_uint ready;
+	atomic_bool go;
+	atomic_bool stop;
+	_Alignas(4096) uint8_t counters[4096];
+} ShareBench;
+
+typedef struct ShareThread {
+	ShareBench *bench;
+	_Atomic uint64_t *counter;
+	pthread_t thread;
+	int cpu;
+	uint64_t ops;
+} ShareThread;
+
+static void *share_worker(void *arg) {
+	ShareThread *t = (ShareThread *)arg;
+	ShareBench *b = t->bench;
+	if (t->cpu >= 0) (void)pin_to_cpu(t->cpu);
+	atomic_fetch_add_explicit(&b->ready, 1u, memory_order_acq_rel);
+	while (!atomic_load_explicit(&b->go, memory_order_acquire)) cpu_relax();
+	uint64_t ops = 0;
+	_Atomic uint64_t *c = t->counter;
+	while (!atomic_load_explicit(&b->stop, memory_order_relaxed)) {
+		// plain load + store, like a per-thread statistics counter (no locked RMW)
+		for (unsigned i = 0; i < 256; ++i) {
+			atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + 1u, memory_order_relaxed);
+		}
+		ops += 256;
+	}
+	t->ops = ops;
+	return NULL;
+}
+
+// Million counter increments per second summed over both threads
+static double run_share_bench(ShareBench *b, const int *cpus, size_t separation, unsigned duration_ms) {
+	memset(b->counters, 0, sizeof(b->counters));
+	atomic_store(&b->ready, 0u);
+	atomic_store(&b->go, false);
+	atomic_store(&b->stop, false);
+	ShareThread threads[2];
+	memset(threads, 0, sizeof(threads));
+	size_t started = 0;
+	for (size_t i = 0; i < 2; ++i) {
+		threads[i].bench = b;
+		threads[i].cpu = cpus[i];
+		threads[i].counter = (_Atomic uint64_t *)(void *)(b->counters + (i == 0 ? 0 : separation));
+		if (pthread_create(&threads[i].thread, NULL, share_worker, &threads[i]) != 0) break;
+		started++;
+	}
+	while (atomic_load_explicit(&b->ready, memory_order_acquire) < (unsigned)started) cpu_relax();
+	uint64_t t0 = now_ns();
+	atomic_store_explicit(&b->go, true, memory_order_release);
+	sleep_ms(duration_ms);
+	atomic_store_explicit(&b->stop, true, memory_order_release);
+	for (size_t i = 0; i < started; ++i) pthread_join(threads[i].thread, NULL);
+	uint64_t t1 = now_ns();
+	if (started != 2) return -1.0;
+	return (double)(threads[0].ops + threads[1].ops) * 1e3 / (double)(t1 - t0);
+}
+
+// Sweep counter separation 0..512 bytes and report the smallest separation from which
+// throughput stays within 10% of the fully separated case.
+static int run_false_sharing_mode(const Options *opt) {
+	int cpus[2] = {-1, -1};
+	if (opt->num_cpus >= 2) {
+		cpus[0] = opt->cpus[0];
+		cpus[1] = opt->cpus[1];
+	} else {
+		CpuInfo *topo = (CpuInfo *)calloc(MAX_CPUS, sizeof(CpuInfo));
+		int *list = (int *)calloc(MAX_CPUS, sizeof(int));
+		if (!topo || !list) {
+			fprintf(stderr, "Topology allocation failed\n");
+			free(topo);
+			free(list);
+			return 1;
+		}
+		size_t n = read_topology(topo, MAX_CPUS);
+		// prefer two cores sharing L3, then farther placements, then SMT siblings
+		const Placement prefs[] = {PLACEMENT_SAME_L3, PLACEMENT_CROSS_L3, PLACEMENT_CROSS_SOCKET, PLACEMENT_SMT};
+		for (size_t k = 0; k < sizeof(prefs) / sizeof(prefs[0]) && cpus[1] < 0; ++k) {
+			if (placement_cpus(topo, n, prefs[k], list, MAX_CPUS) >= 2) {
+				cpus[0] = list[0];
+				cpus[1] = list[1];
+			}
+		}
+		free(list);
+		free(topo);
+		if (cpus[1] < 0) {
+			fprintf(stderr, "False sharing mode needs two CPUs; pass --cpus A,B to force a placement.\n");
+			return 1;
+		}
+	}
+	ShareBench *b = NULL;
+	if (posix_memalign((void **)&b, 4096, sizeof(ShareBench)) != 0 || !b) {
+		fprintf(stderr, "Allocation failed\n");
+		return 1;
+	}
+	memset(b, 0, sizeof(*b));
+
+	const size_t max_sep = 512;
+	const size_t step = 8;
+	double mops[512 / 8 + 1];
+	if (opt->json) {
+		printf("{\"type\":\"config\",\"mode\":\"%s\",\"cpus\":\"%d,%d\",\"duration_ms\":%u}\n", mode_name(opt->mode), cpus[0], cpus[1], opt->target_ms);
+	} else if (opt->print_table) {
+		printf("# False sharing: two threads on CPUs %d,%d incrementing counters separation bytes apart\n", cpus[0], cpus[1]);
+		printf("# separation_bytes\tmops_per_s\n");
+	}
+	for (size_t sep = 0; sep <= max_sep; sep += step) {
+		double best = -1.0;
+		for (unsigned r = 0; r < opt->repeats; ++r) {
+			double v = run_share_bench(b, cpus, sep, opt->target_ms);
+			if (v > best) best = v;
+		}
+		mops[sep / step] = best;
+		if (opt->json) {
+			printf("{\"type\":\"false_sharing\",\"separation_bytes\":%zu,\"mops_per_s\":%.3f}\n", sep, best);
+		} else if (opt->print_table) {
+			printf("%zu\t%.3f\n", sep, best);
+		}
+		fflush(stdout);
+	}
+	// reference: separations of 256 bytes and more are on distinct line pairs everywhere we know of
+	double plateau = 0.0;
+	size_t plateau_n = 0;
+	for (size_t sep = 256; sep <= max_sep; sep += step) {
+		plateau += mops[sep / step];
+		plateau_n++;
+	}
+	plateau /= (double)plateau_n;
+	size_t interference = max_sep;
+	for (size_t sep = max_sep; ; sep -= step) {
+		if (mops[sep / step] < 0.9 * plateau) break;
+		interference = sep;
+		if (sep == 0) break;
+	}
+	size_t padding = 8;
+	while (padding < interference) padding <<= 1;
+	if (opt->json) {
+		printf("{\"type\":\"interference\",\"destructive_interference_bytes\":%zu,\"recommended_padding_bytes\":%zu,\"plateau_mops_per_s\":%.3f}\n",
+			interference, padding, plateau);
+	} else {
+		printf("\nDestructive interference size ~ %zu bytes (recommended counter padding: %zu bytes)\n", interference, padding);
+	}
+	free(b);
+	return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Producer/consumer handoff bandwidth between every pair of CPUs
+// ---------------------------------------------------------------------------
+
+typedef struct Handoff {
+	uint64_t *buf;
+	size_t words;
+	int cpu[2];          // producer, consumer
+	atomic_uint seq;     // even: producer writes round seq/2, odd: consumer reads it
+	atomic_bool stop;
+	uint64_t write_ns;   // best round per side
+	uint64_t read_ns;
+} Handoff;
+
+// Spin until seq has the wanted parity or stop is set; yields now and then so time-sharing
+// one CPU (duplicate --cpus entries) still makes progress
+static bool handoff_wait(Handoff *h, unsigned parity, unsigned *seq) {
+	unsigned spins = 0;
+	for (;;) {
+		unsigned s = atomic_load_explicit(&h->seq, memory_order_acquire);
+		if ((s & 1u) == parity) {
+			*seq = s;
+			return true;
+		}
+		if (atomic_load_explicit(&h->stop, memory_order_relaxed)) return false;
+		if (++spins >= (1u << 14)) {
+			sched_yield();
+			spins = 0;
+		} else {
+			cpu_relax();
+		}
+	}
+}
+
+static void *handoff_producer(void *arg) {
+	Handoff *h = (Handoff *)arg;
+	(void)pin_to_cpu(h->cpu[0]);
+	unsigned seq;
+	while (handoff_wait(h, 0u, &seq)) {
+		uint64_t v = seq;
+		uint64_t t0 = now_ns();
+		for (size_t i = 0; i < h->words; ++i) h->buf[i] = v + i;
+		uint64_t t1 = now_ns();
+		if (h->write_ns == 0 || t1 - t0 < h->write_ns) h->write_ns = t1 - t0;
+		atomic_store_explicit(&h->seq, seq + 1u, memory_order_release);
+	}
+	return NULL;
+}
+
+static void *handoff_consumer(void *arg) {
+	Handoff *h = (Handoff *)arg;
+	(void)pin_to_cpu(h->cpu[1]);
+	unsigned seq;
+	uint64_t sum = 0;
+	while (handoff_wait(h, 1u, &seq)) {
+		uint64_t t0 = now_ns();
+		for (size_t i = 0; i < h->words; ++i) sum += ((const volatile uint64_t *)h->buf)[i];
+		uint64_t t1 = now_ns();
+		if (h->read_ns == 0 || t1 - t0 < h->read_ns) h->read_ns = t1 - t0;
+		atomic_store_explicit(&h->seq, seq + 1u, memory_order_release);
+	}
+	g_sink = (void *)(uintptr_t)sum;
+	return NULL;
+}
+
+// Placement of a CPU pair by the closest cache they share
+static const char *pair_placement(const CpuInfo *topo, size_t n, int a, int b) {
+	const CpuInfo *x = NULL, *y = NULL;
+	for (size_t i = 0; i < n; ++i) {
+		if (topo[i].cpu == a) x = &topo[i];
+		if (topo[i].cpu == b) y = &topo[i];
+	}
+	if (a == b) return "same-cpu";
+	if (!x || !y) return "unknown";
+	if (x->package != y->package) return placement_name(PLACEMENT_CROSS_SOCKET);
+	if (x->core == y->core) return placement_name(PLACEMENT_SMT);
+	if (x->l3 >= 0 && x->l3 == y->l3) return placement_name(PLACEMENT_SAME_L3);
+	return placement_name(PLACEMENT_CROSS_L3);
+}
+
+#define HANDOFF_MAX_CPUS 64
+
+// For buffer sizes at half of L1, L2 and L3 and at 4x L3 (through memory), and every ordered
+// pair of CPUs: the producer writes the whole buffer, then the consumer reads it, alternating
+// for about target_ms. Reports the best consumer read (and producer write) rate per pair,
+// a matrix per size and the mean per placement.
+static int run_handoff_mode(const Options *opt) {
+	CpuInfo *topo = (CpuInfo *)calloc(MAX_CPUS, sizeof(CpuInfo));
+	if (!topo) {
+		fprintf(stderr, "Topology allocation failed\n");
+		return 1;
+	}
+	size_t ntopo = read_topology(topo, MAX_CPUS);
+	int cpus[HANDOFF_MAX_CPUS];
+	size_t ncpus = 0;
+	if (opt->num_cpus >= 2) {
+		for (size_t i = 0; i < opt->num_cpus && ncpus < HANDOFF_MAX_CPUS; ++i) cpus[ncpus++] = opt->cpus[i];
+	} else {
+		// one CPU per physical core
+		for (size_t i = 0; i < ntopo && ncpus < HANDOFF_MAX_CPUS; ++i) {
+			bool seen = false;
+			for (size_t k = 0; k < i; ++k) seen = seen || (topo[k].core == topo[i].core && topo[k].package == topo[i].package);
+			if (!seen) cpus[ncpus++] = topo[i].cpu;
+		}
+	}
+	if (ncpus < 2) {
+		fprintf(stderr, "Handoff mode needs two CPUs; pass --cpus A,B (repeat a CPU to time-share it).\n");
+		free(topo);
+		return 1;
+	}
+
+	size_t cs[4], sizes[4], nsizes = 0;
+	size_t levels = opt->num_cache_sizes ? opt->num_cache_sizes : read_sysfs_cache_sizes(opt->cpu >= 0 ? opt->cpu : cpus[0], cs, 4);
+	if (opt->num_cache_sizes) {
+		for (size_t i = 0; i < 4; ++i) cs[i] = i < levels ? opt->cache_sizes[i] : 0;
+	}
+	if (levels > 3) levels = 3;
+	for (size_t l = 0; l < levels; ++l) {
+		if (cs[l]) sizes[nsizes++] = cs[l] / 2;
+	}
+	size_t llc = nsizes ? cs[levels - 1] : 0;
+	if (nsizes == 0) {
+		sizes[nsizes++] = 16 * 1024;
+		sizes[nsizes++] = 256 * 1024;
+		sizes[nsizes++] = 4 * 1024 * 1024;
+		llc = 32 * 1024 * 1024;
+	}
+	sizes[nsizes++] = llc * 4;
+	while (nsizes > 1 && sizes[nsizes - 1] > opt->max_bytes) nsizes--;
+	size_t max_size = sizes[nsizes - 1];
+	uint64_t *buf = NULL;
+	double *read_gbps = (double *)calloc(ncpus * ncpus, sizeof(double));
+	if (!read_gbps || posix_memalign((void **)&buf, 4096, max_size) != 0 || !buf) {
+		fprintf(stderr, "Allocation failed\n");
+		free(read_gbps);
+		free(topo);
+		return 1;
+	}
+	memset(buf, 0, max_size);
+
+	if (opt->json) {
+		printf("{\"type\":\"config\",\"mode\":\"%s\",\"cpus\":%zu,\"sizes\":%zu,\"duration_ms\":%u}\n", mode_name(opt->mode), ncpus, nsizes, opt->target_ms);
+	} else if (opt->print_table) {
+		printf("# Producer/consumer handoff: producer writes size_bytes, consumer on another CPU reads it (%zu CPUs, %ums per pair)\n",
+			ncpus, opt->target_ms);
+		printf("# size_bytes\tproducer\tconsumer\tplacement\tread_gbps\twrite_gbps\n");
+	}
+	for (size_t si = 0; si < nsizes; ++si) {
+		size_t s = sizes[si];
+		for (size_t i = 0; i < ncpus; ++i) {
+			for (size_t j = 0; j < ncpus; ++j) {
+				if (i == j) continue;
+				Handoff h;
+				memset(&h, 0, sizeof(h));
+				h.buf = buf;
+				h.words = s / sizeof(uint64_t);
+				h.cpu[0] = cpus[i];
+				h.cpu[1] = cpus[j];
+				atomic_init(&h.seq, 0u);
+				atomic_init(&h.stop, false);
+				pthread_t th[2];
+				if (pthread_create(&th[0], NULL, handoff_producer, &h) != 0) continue;
+				if (pthread_create(&th[1], NULL, handoff_consumer, &h) != 0) {
+					atomic_store(&h.stop, true);
+					pthread_join(th[0], NULL);
+					continue;
+				}
+				sleep_ms(opt->target_ms);
+				atomic_store(&h.stop, true);
+				pthread_join(th[0], NULL);
+				pthread_join(th[1], NULL);
+				double rd = h.read_ns ? (double)s / (double)h.read_ns : 0.0;
+				double wr = h.write_ns ? (double)s / (double)h.write_ns : 0.0;
+				read_gbps[i * ncpus + j] = rd;
+				const char *pl = pair_placement(topo, ntopo, cpus[i], cpus[j]);
+				if (opt->json) {
+					printf("{\"type\":\"handoff\",\"size_bytes\":%zu,\"producer\":%d,\"consumer\":%d,\"placement\":\"%s\",\"read_gbps\":%.3f,\"write_gbps\":%.3f}\n",
+						s, cpus[i], cpus[j], pl, rd, wr);
+				} else if (opt->print_table) {
+					printf("%zu\t%d\t%d\t%s\t%.3f\t%.3f\n", s, cpus[i], cpus[j], pl, rd, wr);
+				}
+				fflush(stdout);
+			}
+		}
+		// read matrix (rows: producer, columns: consumer) and the mean per placement
+		char b[32];
+		if (!opt->json) {
+			printf("\n# %s read GB/s, producer rows x consumer columns\n#\t", human_size(s, b, sizeof(b)));
+			for (size_t j = 0; j < ncpus; ++j) printf("%d%s", cpus[j], j + 1 < ncpus ? "\t" : "\n");
+			for (size_t i = 0; i < ncpus; ++i) {
+				printf("# %d", cpus[i]);
+				for (size_t j = 0; j < ncpus; ++j) {
+					if (i == j) printf("\t-");
+					else printf("\t%.2f", read_gbps[i * ncpus + j]);
+				}
+				printf("\n");
+			}
+		}
+		const char *classes[] = {"same-cpu", "smt", "same-l3", "cross-l3", "cross-socket"};
+		for (size_t c = 0; c < sizeof(classes) / sizeof(classes[0]); ++c) {
+			double sum = 0.0;
+			size_t cnt = 0;
+			for (size_t i = 0; i < ncpus; ++i) {
+				for (size_t j = 0; j < ncpus; ++j) {
+					if (i == j || strcmp(pair_placement(topo, ntopo, cpus[i], cpus[j]), classes[c]) != 0) continue;
+					sum += read_gbps[i * ncpus + j];
+					cnt++;
+				}
+			}
+			if (cnt == 0) continue;
+			if (opt->json) {
+				printf("{\"type\":\"handoff_placement\",\"size_bytes\":%zu,\"placement\":\"%s\",\"pairs\":%zu,\"read_gbps\":%.3f}\n", s, classes[c], cnt, sum / (double)cnt);
+			} else {
+				printf("# %s mean over %zu %s pairs: %.2f GB/s\n", human_size(s, b, sizeof(b)), cnt, classes[c], sum / (double)cnt);
+			}
+		}
+		if (!opt->json && si + 1 < nsizes) printf("\n");
+	}
+	free(buf);
+	free(read_gbps);
+	free(topo);
+	return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Self-benchmark: cost of the tool's own setup building blocks
+// ---------------------------------------------------------------------------
+
+#define BENCH_NODE_STRIDE 16            // pointer + padding: 16M nodes fit in 256 MiB
+#define BENCH_MAX_NODES ((size_t)1 << 24)
+#define BENCH_REGRESSION_PCT 20.0       // slower than the baseline by more than this fails
+
+typedef struct BenchCtx {
+	size_t *order;
+	uint8_t *buf;
+	Random64 rng;
+	Pattern pattern;
+} BenchCtx;
+
+typedef void (*BenchFn)(BenchCtx *c, size_t n);
+
+static void bench_rng_next(BenchCtx *c, size_t n) {
+	uint64_t acc = 0;
+	for (size_t i = 0; i < n; ++i) acc ^= rng_next(&c->rng);
+	g_sink = (void *)(uintptr_t)acc;
+}
+
+static void bench_rng_uniform(BenchCtx *c, size_t n) {
+	size_t acc = 0;
+	for (size_t i = 0; i < n; ++i) acc += rng_uniform(&c->rng, n);
+	g_sink = (void *)(uintptr_t)acc;
+}
+
+static void bench_order(BenchCtx *c, size_t n) {
+	build_order_pattern(c->order, n, &c->rng, c->pattern, 3);
+}
+
+static void bench_link(BenchCtx *c, size_t n) {
+	build_cycle_from_order(c->buf, n, BENCH_NODE_STRIDE, c->order, 0);
+}
+
+static void bench_streaming(BenchCtx *c, size_t n) {
+	build_cycle_streaming(c->buf, n, BENCH_NODE_STRIDE, &c->rng, PATTERN_RANDOM, 0);
+}
+
+// One call per item: sizes for a sweep up to n nodes of 256 bytes
+static void bench_generate_sizes(BenchCtx *c, size_t n) {
+	size_t sizes[1024];
+	(void)c;
+	g_sink = (void *)(uintptr_t)generate_sizes(1024, n * 256, sizes, 1024);
+}
+
+// Best of opt->repeats, each repeating fn until ~target_ms/8 has passed; ns per item
+static double bench_run(BenchFn fn, BenchCtx *c, size_t n, size_t items, const Options *opt) {
+	uint64_t budget = (uint64_t)opt->target_ms * 1000000ull / 8;
+	double best = 1e300;
+	for (unsigned r = 0; r < (opt->repeats ? opt->repeats : 1); ++r) {
+		uint64_t calls = 0;
+		uint64_t t0 = now_ns(), t1;
+		do {
+			fn(c, n);
+			calls++;
+			t1 = now_ns();
+		} while (t1 - t0 < budget);
+		double v = (double)(t1 - t0) / ((double)calls * (double)items);
+		if (v < best) best = v;
+	}
+	return best;
+}
+
+typedef struct BenchResult {
+	char name[40];
+	size_t nodes;
+	double ns;
+} BenchResult;
+
+// Baseline file: one "name nodes ns_per_item" line per result
+static size_t load_bench_baseline(const char *path, BenchResult *out, size_t cap) {
+	FILE *f = fopen(path, "r");
+	if (!f) return 0;
+	size_t n = 0;
+	char line[256];
+	while (n < cap && fgets(line, sizeof(line), f)) {
+		if (line[0] == '#') continue;
+		if (sscanf(line, "%39s %zu %lf", out[n].name, &out[n].nodes, &out[n].ns) == 3) n++;
+	}
+	fclose(f);
+	return n;
+}
+
+static int save_bench_baseline(const char *path, const BenchResult *res, size_t n) {
+	FILE *f = fopen(path, "w");
+	if (!f) {
+		fprintf(stderr, "Cannot write %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+	fprintf(f, "# cache_detect selfbench baseline: name nodes ns_per_item\n");
+	for (size_t i = 0; i < n; ++i) fprintf(f, "%s %zu %.4f\n", res[i].name, res[i].nodes, res[i].ns);
+	fclose(f);
+	return 0;
+}
+
+// rng, every build_order_* generator, cycle linking (from an order and streamed) and
+// generate_sizes at 1K..16M nodes. Items are nodes, except rng (one draw) and
+// generate_sizes (one call). Compared against --bench-baseline, which is written when missing.
+static int run_selfbench_mode(const Options *opt) {
+	static const Pattern patterns[] = {PATTERN_RANDOM, PATTERN_SEQUENTIAL, PATTERN_REVERSE, PATTERN_STRIDE, PATTERN_INTERLEAVE, PATTERN_GRAY, PATTERN_BITREVERSE};
+	const size_t npat = sizeof(patterns) / sizeof(patterns[0]);
+	static const size_t counts[] = {1024, 65536, 1u << 20, BENCH_MAX_NODES};
+	const size_t ncounts = sizeof(counts) / sizeof(counts[0]);
+	BenchCtx c;
+	c.order = (size_t *)malloc(BENCH_MAX_NODES * sizeof(size_t));
+	c.buf = (uint8_t *)calloc(BENCH_MAX_NODES, BENCH_NODE_STRIDE);
+	c.rng.state = 0x9e3779b97f4a7c15ULL;
+	c.pattern = PATTERN_RANDOM;
+	BenchResult *res = (BenchResult *)calloc(ncounts * (npat + 5), sizeof(BenchResult));
+	BenchResult *base = (BenchResult *)calloc(1024, sizeof(BenchResult));
+	if (!c.order || !c.buf || !res || !base) {
+		fprintf(stderr, "Allocation failed\n");
+		free(c.order);
+		free(c.buf);
+		free(res);
+		free(base);
+		return 1;
+	}
+	size_t nbase = opt->bench_baseline ? load_bench_baseline(opt->bench_baseline, base, 1024) : 0;
+	if (opt->json) {
+		printf("{\"type\":\"config\",\"mode\":\"selfbench\",\"baseline\":\"%s\",\"baseline_entries\":%zu,\"target_ms\":%u,\"repeats\":%u}\n",
+			opt->bench_baseline ? opt->bench_baseline : "", nbase, opt->target_ms, opt->repeats);
+	} else if (opt->print_table) {
+		printf("# Self-benchmark of setup building blocks (baseline: %s)\n", nbase ? opt->bench_baseline : "none");
+		printf("# name\tnodes\tns_per_item\tbaseline_ns\tchange_pct\n");
+	}
+	size_t nres = 0, regressions = 0;
+	for (size_t ci = 0; ci < ncounts; ++ci) {
+		size_t n = counts[ci];
+		for (size_t k = 0; k < npat + 5; ++k) {
+			BenchResult *r = &res[nres++];
+			r->nodes = n;
+			if (k < npat) {
+				c.pattern = patterns[k];
+				snprintf(r->name, sizeof(r->name), "build_order_%s", pattern_name(patterns[k]));
+				r->ns = bench_run(bench_order, &c, n, n, opt);
+			} else if (k == npat) {
+				snprintf(r->name, sizeof(r->name), "rng_next");
+				r->ns = bench_run(bench_rng_next, &c, n, n, opt);
+			} else if (k == npat + 1) {
+				snprintf(r->name, sizeof(r->name), "rng_uniform");
+				r->ns = bench_run(bench_rng_uniform, &c, n, n, opt);
+			} else if (k == npat + 2) {
+				build_order_random(c.order, n, &c.rng);
+				snprintf(r->name, sizeof(r->name), "build_cycle_from_order");
+				r->ns = bench_run(bench_link, &c, n, n, opt);
+			} else if (k == npat + 3) {
+				snprintf(r->name, sizeof(r->name), "build_cycle_streaming");
+				r->ns = bench_run(bench_streaming, &c, n, n, opt);
+			} else {
+				snprintf(r->name, sizeof(r->name), "generate_sizes");
+				r->ns = bench_run(bench_generate_sizes, &c, n, 1, opt);
+			}
+			double ref = 0.0;
+			for (size_t b = 0; b < nbase; ++b) {
+				if (base[b].nodes == n && strcmp(base[b].name, r->name) == 0) ref = base[b].ns;
+			}
+			double change = ref > 0.0 ? (r->ns / ref - 1.0) * 100.0 : 0.0;
+			bool regressed = ref > 0.0 && change > BENCH_REGRESSION_PCT;
+			if (regressed) regressions++;
+			if (opt->json) {
+				printf("{\"type\":\"selfbench\",\"name\":\"%s\",\"nodes\":%zu,\"ns_per_item\":%.4f,\"baseline_ns\":%.4f,\"change_pct\":%.1f,\"regressed\":%s}\n",
+					r->name, n, r->ns, ref, change, regressed ? "true" : "false");
+			} else if (opt->print_table) {
+				printf("%s\t%zu\t%.4f\t%.4f\t%+.1f%s\n", r->name, n, r->ns, ref, change, regressed ? "\tREGRESSION" : "");
+			}
+			fflush(stdout);
+		}
+	}
+	int rc = 0;
+	if (opt->bench_baseline && nbase == 0) {
+		rc = save_bench_baseline(opt->bench_baseline, res, nres);
+		if (rc == 0) fprintf(stderr, "Saved selfbench baseline to %s\n", opt->bench_baseline);
+	} else if (regressions > 0) {
+		fprintf(stderr, "%zu selfbench entries are more than %.0f%% slower than %s\n", regressions, BENCH_REGRESSION_PCT, opt->bench_baseline);
+		rc = 1;
+	}
+	free(base);
+	free(res);
+	free(c.buf);
+	free(c.order);
+	return rc;
+}
+
+// Threaded suites and the self-benchmark manage their own memory and do not need the
+// shared chase buffer
+static bool mode_needs_buffer(Mode m) {
+	return m != MODE_LOCKS && m != MODE_FALSE_SHARING && m != MODE_SELFBENCH && m != MODE_HANDOFF;
+}
+
+// ---------------------------------------------------------------------------
+// Container limits: cgroup v1/v2 memory limit, CPU quota and cpuset
+// ---------------------------------------------------------------------------
+
+typedef struct CgroupLimits {
+	const char *version;   // "v2", "v1" or NULL when no cgroup is found
+	uint64_t mem_limit;    // bytes, 0 = unlimited
+	uint64_t mem_usage;    // bytes charged when probed
+	uint64_t quota_us;     // CPU time per period across all CPUs, 0 = unlimited
+	uint64_t period_us;
+	char cpuset[256];      // effective cpuset list, "" when unknown
+} CgroupLimits;
+
+// First line of a small file without the newline; false when missing
+static bool read_line_file(const char *path, char *buf, size_t n) {
+	FILE *f = fopen(path, "r");
+	if (!f) return false;
+	bool ok = fgets(buf, (int)n, f) != NULL;
+	fclose(f);
+	if (ok) buf[strcspn(buf, "\r\n")] = '\0';
+	return ok;
+}
+
+// Path of this process's cgroup for a v1 controller, or the v2 group when controller is NULL
+static bool own_cgroup_path(const char *controller, char *out, size_t n) {
+	FILE *f = fopen("/proc/self/cgroup", "r");
+	if (!f) return false;
+	char line[1024];
+	bool found = false;
+	while (!found && fgets(line, sizeof(line), f)) {
+		line[strcspn(line, "\r\n")] = '\0';
+		char *c1 = strchr(line, ':');
+		char *c2 = c1 ? strchr(c1 + 1, ':') : NULL;
+		if (!c2) continue;
+		*c1 = '\0';
+		*c2 = '\0';
+		const char *ctrls = c1 + 1;
+		if (controller == NULL) {
+			found = strcmp(line, "0") == 0 && *ctrls == '\0';
+		} else {
+			// comma-separated controller list, e.g. "cpu,cpuacct"
+			size_t len = strlen(controller);
+			for (const char *q = ctrls; *q; ) {
+				if (strncmp(q, controller, len) == 0 && (q[len] == ',' || q[len] == '\0')) {
+					found = true;
+					break;
+				}
+				const char *comma = strchr(q, ',');
+				if (!comma) break;
+				q = comma + 1;
+			}
+		}
+		if (found) snprintf(out, n, "%s", c2 + 1);
+	}
+	fclose(f);
+	return found;
+}
+
+// Read name from the group dir/path or its nearest ancestor that has it (inside a cgroup
+// namespace the listed path may not exist and the group sits at the mount root)
+static bool read_cgroup_file(const char *dir, const char *path, const char *name, char *buf, size_t n) {
+	char rel[512];
+	snprintf(rel, sizeof(rel), "%s", path);
+	for (;;) {
+		char full[1024];
+		snprintf(full, sizeof(full), "%s%s/%s", dir, strcmp(rel, "/") == 0 ? "" : rel, name);
+		if (read_line_file(full, buf, n)) return true;
+		char *slash = strrchr(rel, '/');
+		if (!slash || slash == rel) {
+			if (strcmp(rel, "/") == 0) return false;
+			snprintf(rel, sizeof(rel), "/");
+		} else {
+			*slash = '\0';
+		}
+	}
+}
+
+// Tightest memory limit from the group up to the root (parents cap their children)
+static uint64_t cgroup_min_limit(const char *dir, const char *path, const char *name, uint64_t unlimited_above) {
+	char rel[512];
+	snprintf(rel, sizeof(rel), "%s", path);
+	uint64_t best = 0;
+	for (;;) {
+		char full[1024], buf[64];
+		snprintf(full, sizeof(full), "%s%s/%s", dir, strcmp(rel, "/") == 0 ? "" : rel, name);
+		if (read_line_file(full, buf, sizeof(buf)) && strcmp(buf, "max") != 0) {
+			uint64_t v = strtoull(buf, NULL, 10);
+			if (v > 0 && v < unlimited_above && (best == 0 || v < best)) best = v;
+		}
+		char *slash = strrchr(rel, '/');
+		if (!slash || strcmp(rel, "/") == 0) break;
+		if (slash == rel) snprintf(rel, sizeof(rel), "/");
+		else *slash = '\0';
+	}
+	return best;
+}
+
+// Tightest CPU quota (quota/period) from the group up to the root: v2 cpu.max, or v1
+// cpu.cfs_quota_us with cpu.cfs_period_us. Leaves both 0 when no level is limited.
+static void cgroup_min_cpu_quota(const char *dir, const char *path, bool v1, uint64_t *quota_us, uint64_t *period_us) {
+	char rel[512];
+	snprintf(rel, sizeof(rel), "%s", path);
+	*quota_us = 0;
+	*period_us = 0;
+	for (;;) {
+		char full[1024], buf[64];
+		const char *sep = strcmp(rel, "/") == 0 ? "" : rel;
+		uint64_t q = 0, p = 0;
+		if (v1) {
+			snprintf(full, sizeof(full), "%s%s/cpu.cfs_quota_us", dir, sep);
+			long long v = read_line_file(full, buf, sizeof(buf)) ? strtoll(buf, NULL, 10) : -1;
+			snprintf(full, sizeof(full), "%s%s/cpu.cfs_period_us", dir, sep);
+			if (v > 0 && read_line_file(full, buf, sizeof(buf))) {
+				q = (uint64_t)v;
+				p = strtoull(buf, NULL, 10);
+			}
+		} else {
+			snprintf(full, sizeof(full), "%s%s/cpu.max", dir, sep);
+			if (read_line_file(full, buf, sizeof(buf)) && strncmp(buf, "max", 3) != 0) {
+				char *end = NULL;
+				q = strtoull(buf, &end, 10);
+				p = end ? strtoull(end, NULL, 10) : 0;
+			}
+		}
+		// compare q/p against the best so far without dividing
+		if (q > 0 && p > 0 && (*period_us == 0 || (double)q * (double)*period_us < (double)*quota_us * (double)p)) {
+			*quota_us = q;
+			*period_us = p;
+		}
+		char *slash = strrchr(rel, '/');
+		if (!slash || strcmp(rel, "/") == 0) break;
+		if (slash == rel) snprintf(rel, sizeof(rel), "/");
+		else *slash = '\0';
+	}
+}
+
+// Probe the limits of this process's cgroup under root (normally /sys/fs/cgroup)
+static void read_cgroup_limits(const char *root, CgroupLimits *lim) {
+	memset(lim, 0, sizeof(*lim));
+#if defined(__linux__)
+	char dir[512], path[512], buf[256];
+	snprintf(dir, sizeof(dir), "%s/memory", root);
+	bool v1 = own_cgroup_path("memory", path, sizeof(path)) && access(dir, F_OK) == 0;
+	if (v1) {
+		lim->version = "v1";
+		lim->mem_limit = cgroup_min_limit(dir, path, "memory.limit_in_bytes", 1ull << 60);
+		if (read_cgroup_file(dir, path, "memory.usage_in_bytes", buf, sizeof(buf))) lim->mem_usage = strtoull(buf, NULL, 10);
+		snprintf(dir, sizeof(dir), "%s/cpu", root);
+		if (own_cgroup_path("cpu", path, sizeof(path))) cgroup_min_cpu_quota(dir, path, true, &lim->quota_us, &lim->period_us);
+		snprintf(dir, sizeof(dir), "%s/cpuset", root);
+		if (own_cgroup_path("cpuset", path, sizeof(path))) {
+			if (!read_cgroup_file(dir, path, "cpuset.effective_cpus", lim->cpuset, sizeof(lim->cpuset))) {
+				if (!read_cgroup_file(dir, path, "cpuset.cpus", lim->cpuset, sizeof(lim->cpuset))) lim->cpuset[0] = '\0';
+			}
+		}
+		return;
+	}
+	if (!own_cgroup_path(NULL, path, sizeof(path))) return;
+	char probe[600];
+	snprintf(dir, sizeof(dir), "%s", root);
+	snprintf(probe, sizeof(probe), "%s/cgroup.controllers", dir);
+	if (access(probe, F_OK) != 0) {
+		snprintf(dir, sizeof(dir), "%s/unified", root); // hybrid layout
+		snprintf(probe, sizeof(probe), "%s/cgroup.controllers", dir);
+		if (access(probe, F_OK) != 0) return;
+	}
+	lim->version = "v2";
+	lim->mem_limit = cgroup_min_limit(dir, path, "memory.max", UINT64_MAX);
+	if (read_cgroup_file(dir, path, "memory.current", buf, sizeof(buf))) lim->mem_usage = strtoull(buf, NULL, 10);
+	cgroup_min_cpu_quota(dir, path, false, &lim->quota_us, &lim->period_us);
+	if (!read_cgroup_file(dir, path, "cpuset.cpus.effective", lim->cpuset, sizeof(lim->cpuset))) lim->cpuset[0] = '\0';
+#else
+	(void)root;
+#endif
+}
+
+static bool cgroup_constrained(const CgroupLimits *lim) {
+	return lim->mem_limit != 0 || lim->quota_us != 0;
+}
+
+// Memory the shared buffer and its scratch may use: 3/4 of what the limit leaves free
+static uint64_t cgroup_buffer_budget(const CgroupLimits *lim) {
+	if (lim->mem_limit == 0) return 0;
+	uint64_t free_bytes = lim->mem_limit > lim->mem_usage ? lim->mem_limit - lim->mem_usage : 0;
+	return free_bytes / 4 * 3;
+}
+
+// Fit one run's options to the limits: an explicit CPU outside the cpuset is replaced, thread
+// sweeps stop at the quota, and timed runs fit in one quota slice when under one CPU.
+static void apply_cgroup_limits(const CgroupLimits *lim, Options *opt) {
+	if (lim->cpuset[0] != '\0' && opt->cpu >= 0) {
+		int allowed[MAX_CPU_LIST];
+		size_t n = parse_cpu_list(lim->cpuset, allowed, MAX_CPU_LIST);
+		bool ok = false;
+		for (size_t i = 0; i < n; ++i) ok = ok || allowed[i] == opt->cpu;
+		if (n > 0 && !ok) {
+			fprintf(stderr, "CPU %d is outside the cgroup cpuset %s; using CPU %d\n", opt->cpu, lim->cpuset, allowed[0]);
+			opt->cpu = allowed[0];
+		}
+	}
+	if (lim->quota_us != 0 && lim->period_us != 0) {
+		unsigned cpus = (unsigned)((lim->quota_us + lim->period_us - 1) / lim->period_us);
+		if (cpus < 1) cpus = 1;
+		if (opt->max_threads > cpus) opt->max_threads = cpus < 2 ? 2 : cpus;
+		if (lim->quota_us < lim->period_us) {
+			unsigned slice_ms = (unsigned)(lim->quota_us / 2000);
+			if (slice_ms < 1) slice_ms = 1;
+			if (opt->target_ms > slice_ms) opt->target_ms = slice_ms;
+		}
+	}
+}
+
+static void print_cgroup_limits(const Options *opt, const CgroupLimits *lim) {
+	if (!lim->version) return;
+	double quota = lim->period_us ? (double)lim->quota_us / (double)lim->period_us : 0.0;
+	if (opt->json) {
+		printf("{\"type\":\"cgroup\",\"version\":\"%s\",\"memory_limit_bytes\":%" PRIu64 ",\"memory_usage_bytes\":%" PRIu64 ",\"cpu_quota\":%.3f,\"cpuset\":\"%s\"}\n",
+			lim->version, lim->mem_limit, lim->mem_usage, quota, lim->cpuset);
+	} else if (cgroup_constrained(lim)) {
+		char b1[32], b2[32];
+		printf("# cgroup %s: memory limit %s (%s in use), CPU quota ", lim->version,
+			lim->mem_limit ? human_size((size_t)lim->mem_limit, b1, sizeof(b1)) : "none", human_size((size_t)lim->mem_usage, b2, sizeof(b2)));
+		if (quota > 0.0) printf("%.2f CPUs", quota);
+		else printf("none");
+		printf(", cpuset %s\n", lim->cpuset[0] ? lim->cpuset : "unknown");
+	}
+}
+
+// ---------------------------------------------------------------------------
+// Experiment plans: many configurations in one process over one shared buffer
+// ---------------------------------------------------------------------------
+
+typedef struct Plan {
+	Options *runs;
+	char **lines;   // source line of each run, for reporting
+	char **tokens;  // tokenized copy; string options of the run point into it
+	size_t count;
+} Plan;
+
+static void free_plan(Plan *plan) {
+	for (size_t i = 0; i < plan->count; ++i) {
+		free(plan->lines[i]);
+		free(plan->tokens[i]);
+	}
+	free(plan->lines);
+	free(plan->tokens);
+	free(plan->runs);
+	memset(plan, 0, sizeof(*plan));
+}
+
+// Split a plan line in place into argv-style tokens ("..." groups spaces); stops at '#'
+static int tokenize_line(char *line, char **argv, int cap) {
+	int argc = 0;
+	char *p = line;
+	while (*p && argc < cap) {
+		while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+		if (!*p || *p == '#') break;
+		char quote = (*p == '"' || *p == '\'') ? *p++ : 0;
+		argv[argc++] = p;
+		while (*p && (quote ? *p != quote : (*p != ' ' && *p != '\t' && *p != '\r' && *p != '\n'))) p++;
+		if (*p) *p++ = '\0';
+	}
+	return argc;
+}
+
+// Read a plan: one experiment per non-empty line, its options applied on top of base
+// (the command line before sanity bounds). Returns 0 on success.
+static int load_plan(const char *path, const Options *base, Plan *plan) {
+	memset(plan, 0, sizeof(*plan));
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "Cannot open plan '%s': %s\n", path, strerror(errno));
+		return 1;
+	}
+	size_t cap = 0;
+	char buf[4096];
+	while (fgets(buf, sizeof(buf), f)) {
+		buf[strcspn(buf, "\r\n")] = '\0';
+		char *tokens = strdup(buf);
+		char *argv[128];
+		argv[0] = (char *)"plan";
+		int argc = tokens ? 1 + tokenize_line(tokens, argv + 1, 127) : 0;
+		if (argc <= 1) {
+			free(tokens);
+			continue;
+		}
+		if (plan->count == cap) {
+			size_t ncap = cap ? cap * 2 : 16;
+			Options *runs = (Options *)realloc(plan->runs, ncap * sizeof(Options));
+			if (runs) plan->runs = runs;
+			char **lines = (char **)realloc(plan->lines, ncap * sizeof(char *));
+			if (lines) plan->lines = lines;
+			char **toks = (char **)realloc(plan->tokens, ncap * sizeof(char *));
+			if (toks) plan->tokens = toks;
+			if (!runs || !lines || !toks) {
+				free(tokens);
+				fclose(f);
+				free_plan(plan);
+				fprintf(stderr, "Allocation failed\n");
+				return 1;
+			}
+			cap = ncap;
+		}
+		Options *o = &plan->runs[plan->count];
+		*o = *base;
+		o->plan_path = NULL;
+		apply_args(argc, argv, o, true);
+		finalize_options(o);
+		plan->tokens[plan->count] = tokens;
+		plan->lines[plan->count] = strdup(buf);
+		plan->count++;
+	}
+	fclose(f);
+	if (plan->count == 0) {
+		fprintf(stderr, "Plan '%s' has no experiments\n", path);
+		return 1;
+	}
+	return 0;
+}
+
+// Buffers from this size up are mapped with huge-page advice (fewer TLB misses and page
+// faults on big sweeps); smaller ones come from posix_memalign.
+#define HUGE_BUFFER_BYTES ((size_t)1 << 30)
+// Orders of up to this many nodes fit the permutation scratch; larger cycles are streamed.
+#define MAX_PERM_NODES ((size_t)1 << 26)
+
+static uint64_t physical_memory_bytes(void) {
+#if defined(_SC_PHYS_PAGES)
+	long pages = sysconf(_SC_PHYS_PAGES);
+	if (pages > 0) return (uint64_t)pages * page_size();
+#endif
+	return 0;
+}
+
+// Allocate the shared buffer; NULL with errno set on failure. Release with free_buffer.
+static uint8_t *alloc_buffer(size_t bytes, size_t align, void **raw, size_t *mapped) {
+	*raw = NULL;
+	*mapped = 0;
+	if (bytes >= HUGE_BUFFER_BYTES) {
+		// mappings succeed lazily, so refuse what cannot be backed instead of swapping
+		uint64_t phys = physical_memory_bytes();
+		if (phys != 0 && (uint64_t)bytes > phys / 10 * 9) {
+			errno = ENOMEM;
+			return NULL;
+		}
+		return map_huge(bytes, false, raw, mapped);
+	}
+	int err = posix_memalign(raw, align, bytes);
+	if (err != 0 || *raw == NULL) {
+		errno = err ? err : ENOMEM;
+		*raw = NULL;
+		return NULL;
+	}
+	return (uint8_t *)*raw;
+}
+
+static void free_buffer(void *raw, size_t mapped) {
+	if (mapped) munmap(raw, mapped);
+	else free(raw);
+}
+
+// Print s as a JSON string literal
+static void print_json_string(const char *s) {
+	putchar('"');
+	for (; s && *s; ++s) {
+		unsigned char c = (unsigned char)*s;
+		if (c == '"' || c == '\\') printf("\\%c", c);
+		else if (c < 0x20) printf("\\u%04x", c);
+		else putchar(c);
+	}
+	putchar('"');
+}
+
+// Run one configuration; buffered modes get sizes that fit the shared workspace
+static int run_experiment(const Options *opt, Workspace *ws) {
+	if ((opt->header_path || opt->config_path) && opt->mode != MODE_LATENCY) {
+		fprintf(stderr, "--emit-header/--emit-config need a latency sweep; ignored in %s mode\n", mode_name(opt->mode));
+	}
+	if (!mode_needs_buffer(opt->mode)) {
+		switch (opt->mode) {
+			case MODE_LOCKS: return run_locks_mode(opt);
+			case MODE_FALSE_SHARING: return run_false_sharing_mode(opt);
+			case MODE_SELFBENCH: return run_selfbench_mode(opt);
+			case MODE_HANDOFF: return run_handoff_mode(opt);
+			default: return 1;
+		}
+	}
+	const size_t max_samples = 1024;
+	size_t sizes[max_samples];
+	size_t num_sizes = generate_sizes(opt->min_bytes, opt->max_bytes, sizes, max_samples);
+	// Trim test sizes to those that fit in the allocated buffer and, except for the latency
+	// sweep (which links huge cycles in streaming form), the permutation array
+	bool streams = opt->mode == MODE_LATENCY;
+	while (num_sizes > 0 && (sizes[num_sizes - 1] > ws->bytes || (!streams && sizes[num_sizes - 1] / opt->node_stride > ws->max_nodes))) {
+		num_sizes--;
+	}
+	if (num_sizes == 0) {
+		fprintf(stderr, "No sizes to test.\n");
+		return 1;
+	}
+	if (opt->cpu >= 0 && !pin_to_cpu(opt->cpu)) {
+		fprintf(stderr, "Could not pin to CPU %d; continuing unpinned.\n", opt->cpu);
+	}
+
+	int rc;
+	switch (opt->mode) {
+		case MODE_FENCE: rc = run_fence_mode(opt, ws, sizes, num_sizes); break;
+		case MODE_GATHER: rc = run_gather_mode(opt, ws, sizes, num_sizes); break;
+		case MODE_SPLIT: rc = run_split_mode(opt, ws, sizes, num_sizes); break;
+		case MODE_MEMCPY: rc = run_memcpy_mode(opt, ws, sizes, num_sizes); break;
+		case MODE_ZERO: rc = run_zero_mode(opt, ws, sizes, num_sizes); break;
+		case MODE_TILE: rc = run_tile_mode(opt, ws, sizes, num_sizes); break;
+		case MODE_INCLUSION: rc = run_inclusion_mode(opt, ws, sizes, num_sizes); break;
+		case MODE_REPLACEMENT: rc = run_replacement_mode(opt, ws, sizes, num_sizes); break;
+		case MODE_POLLUTION: rc = run_pollution_mode(opt, ws, sizes, num_sizes); break;
+		case MODE_IO: rc = run_io_mode(opt, ws, sizes, num_sizes); break;
+		case MODE_SCAN: rc = run_scan_mode(opt, ws, sizes, num_sizes); break;
+		case MODE_AMAC: rc = run_amac_mode(opt, ws, sizes, num_sizes); break;
+		case MODE_LATENCY:
+		default:         rc = run_latency_mode(opt, ws, sizes, num_sizes); break;
+	}
+	return rc;
+}
+
+int main(int argc, char **argv) {
+	uint64_t t_start = now_ns();
+	Options opt;
+	default_options(&opt);
+	apply_args(argc, argv, &opt, false);
+	Options base = opt; // plan lines apply on top of the command line before sanity bounds
+	finalize_options(&opt);
+
+	Plan plan = {0};
+	const Options *runs = &opt;
+	size_t num_runs = 1;
+	if (opt.plan_path) {
+		if (load_plan(opt.plan_path, &base, &plan) != 0) return 1;
+		runs = plan.runs;
+		num_runs = plan.count;
+	}
+
+	// Container limits: fit CPU choice, thread sweeps and timing to them, report them
+	CgroupLimits lim;
+	read_cgroup_limits(opt.cgroup_root, &lim);
+	unsigned target_ms = opt.target_ms, max_threads = opt.max_threads;
+	apply_cgroup_limits(&lim, &opt);
+	for (size_t i = 0; i < plan.count; ++i) apply_cgroup_limits(&lim, &plan.runs[i]);
+	if (opt.target_ms != target_ms) fprintf(stderr, "cgroup CPU quota below one CPU: timed runs shortened to %u ms\n", opt.target_ms);
+	if (opt.max_threads != max_threads) fprintf(stderr, "cgroup CPU quota: thread sweeps capped at %u threads\n", opt.max_threads);
+	print_cgroup_limits(&opt, &lim);
+
+	// Energy counters are optional: without readable RAPL zones runs continue without them
+	bool want_energy = false;
+	for (size_t i = 0; i < num_runs; ++i) want_energy = want_energy || runs[i].energy;
+	if (want_energy) {
+		if (rapl_open(opt.powercap_root) == 0) {
+			fprintf(stderr, "No readable RAPL package/DRAM energy counters under %s (absent, or energy_uj needs root); continuing without energy\n", opt.powercap_root);
+		} else if (opt.json) {
+			printf("{\"type\":\"energy\",\"powercap_root\":\"%s\",\"zones\":%zu,\"pkg\":%s,\"dram\":%s}\n", opt.powercap_root, g_rapl_count,
+				g_rapl_has[ENERGY_PKG] ? "true" : "false", g_rapl_has[ENERGY_DRAM] ? "true" : "false");
+		} else {
+			printf("# energy: %zu RAPL zone(s) under %s (package %s, DRAM %s)\n", g_rapl_count, opt.powercap_root,
+				g_rapl_has[ENERGY_PKG] ? "yes" : "no", g_rapl_has[ENERGY_DRAM] ? "yes" : "no");
+		}
+	}
+
+	// One buffer serves every buffered experiment: the largest range, the finest stride
+	size_t min_bytes = SIZE_MAX, max_bytes = 0, min_stride = SIZE_MAX, max_stride = 0;
+	for (size_t i = 0; i < num_runs; ++i) {
+		if (!mode_needs_buffer(runs[i].mode)) continue;
+		if (runs[i].min_bytes < min_bytes) min_bytes = runs[i].min_bytes;
+		if (runs[i].max_bytes > max_bytes) max_bytes = runs[i].max_bytes;
+		if (runs[i].node_stride < min_stride) min_stride = runs[i].node_stride;
+		if (runs[i].node_stride > max_stride) max_stride = runs[i].node_stride;
+	}
+	Workspace ws;
+	memset(&ws, 0, sizeof(ws));
+	void *raw = NULL;
+	size_t mapped = 0;
+	if (max_bytes > 0) {
+		// Generate sizes first
+		const size_t max_samples = 1024;
+		size_t sizes[max_samples];
+		size_t num_sizes = generate_sizes(min_bytes, max_bytes, sizes, max_samples);
+		if (num_sizes == 0) {
+			fprintf(stderr, "No sizes to test.\n");
+			free_plan(&plan);
+			return 1;
+		}
+
+		// Try to allocate a buffer large enough for the largest requested size.
+		// If allocation fails, progressively reduce to the next smaller size.
+		size_t align = page_size();
+		if (max_stride > align && (max_stride & (max_stride - 1)) == 0) align = max_stride;
+		size_t alloc_idx = num_sizes - 1;
+		// Under a cgroup memory limit an overcommitted allocation succeeds and the prefault
+		// gets the process OOM-killed, so stay within the budget (buffer + permutation scratch)
+		uint64_t budget = cgroup_buffer_budget(&lim);
+		if (budget != 0) {
+			size_t top = alloc_idx;
+			while (alloc_idx > 0) {
+				uint64_t nodes = sizes[alloc_idx] / min_stride;
+				if (nodes > MAX_PERM_NODES) nodes = MAX_PERM_NODES;
+				if ((uint64_t)sizes[alloc_idx] + nodes * sizeof(size_t) <= budget) break;
+				alloc_idx--;
+			}
+			if (alloc_idx != top) {
+				char b1[32], b2[32];
+				fprintf(stderr, "cgroup memory limit %s: buffer capped at %s\n", human_size((size_t)lim.mem_limit, b1, sizeof(b1)), human_size(sizes[alloc_idx], b2, sizeof(b2)));
+			}
+		}
+		size_t alloc_bytes = sizes[alloc_idx];
+		uint64_t t_alloc = now_ns();
+		uint8_t *buf = alloc_buffer(alloc_bytes, align, &raw, &mapped);
+		while (!buf && alloc_idx > 0) {
+			fprintf(stderr, "Allocation of %zu bytes failed (%s). Retrying with smaller size...\n", alloc_bytes, strerror(errno));
+			alloc_idx--;
+			alloc_bytes = sizes[alloc_idx];
+			buf = alloc_buffer(alloc_bytes, align, &raw, &mapped);
+		}
+		if (!buf) {
+			fprintf(stderr, "Allocation failed even for smallest size (%zu bytes): %s\n", alloc_bytes, strerror(errno));
+			free_plan(&plan);
+			return 1;
+		}
+		phase_add(PHASE_ALLOC, t_alloc);
+		ws.base = buf;
+		ws.bytes = alloc_bytes;
+		// Mapped buffers are zero-filled already and get faulted in by the first cycle build;
+		// prefaulting hundreds of GiB up front would dominate the run.
+		uint64_t t_memset = now_ns();
+		if (!mapped) memset(ws.base, 0, alloc_bytes);
+		phase_add(PHASE_MEMSET, t_memset);
+
+		// Prepare permutation array for up to max nodes within allocated buffer; larger
+		// cycles are linked without it
+		ws.max_nodes = alloc_bytes / min_stride;
+		if (ws.max_nodes > MAX_PERM_NODES) ws.max_nodes = MAX_PERM_NODES;
+		t_alloc = now_ns();
+		ws.perm = (size_t *)malloc(ws.max_nodes * sizeof(size_t));
+		phase_add(PHASE_ALLOC, t_alloc);
+		if (!ws.perm) {
+			fprintf(stderr, "Permutation allocation failed\n");
+			free_buffer(raw, mapped);
+			free_plan(&plan);
+			return 1;
+		}
+	}
+
+	// seed from address entropy and time
+	uint64_t seed = (uint64_t)now_ns() ^ (uint64_t)(uintptr_t)&ws ^ (uint64_t)getpid();
+	if (seed == 0) seed = 0x123456789abcdefULL;
+	ws.rng.state = seed;
+
+	int rc = 0;
+	if (!opt.plan_path) {
+		rc = run_experiment(&opt, &ws);
+	} else {
+		save_affinity();
+		size_t failed = 0;
+		for (size_t i = 0; i < num_runs; ++i) {
+			const char *line = plan.lines[i] ? plan.lines[i] : "";
+			if (runs[i].json) {
+				printf("{\"type\":\"experiment\",\"index\":%zu,\"count\":%zu,\"mode\":\"%s\",\"args\":", i, num_runs, mode_name(runs[i].mode));
+				print_json_string(line);
+				printf("}\n");
+			} else {
+				printf("%s# experiment %zu/%zu: %s\n", i ? "\n" : "", i + 1, num_runs, line);
+			}
+			fflush(stdout);
+			restore_affinity();
+			if (run_experiment(&runs[i], &ws) != 0) failed++;
+			fflush(stdout);
+		}
+		if (opt.json) {
+			printf("{\"type\":\"plan\",\"experiments\":%zu,\"failed\":%zu}\n", num_runs, failed);
+		} else {
+			printf("\n# plan: %zu experiments, %zu failed\n", num_runs, failed);
+		}
+		rc = failed ? 1 : 0;
+	}
+
+	report_phases(&opt, g_phase_ns, 0, now_ns() - t_start);
+	free(ws.perm);
+	free_buffer(raw, mapped);
+	free_plan(&plan);
+	return rc;
+}